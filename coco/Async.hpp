@@ -0,0 +1,192 @@
+#pragma once
+
+#include <coco/Coroutine.hpp>
+
+
+namespace coco {
+
+/**
+ * Base class of the synchronization primitives for coroutines on one loop. The waiting coroutines are in an
+ * intrusive list, therefore nothing gets allocated and waiting for a mutex, semaphore or event can be combined with
+ * Loop::withTimeout(). A timed out arrival at a barrier is not withdrawn, therefore AsyncBarrier::arrive() can't.
+ * For coroutines on different loops use the _native variants in <coco/platform/Async_native.hpp>.
+ */
+class AsyncWaitList {
+protected:
+    // resume the coroutines that are waiting now, coroutines that wait again while being resumed stay in the list
+    void resumeAll() {
+        int count = 0;
+        for (auto it = this->waiters.begin(); it != this->waiters.end(); ++it)
+            ++count;
+        while (count > 0) {
+            this->waiters.doFirst();
+            --count;
+        }
+    }
+
+    CoroutineTaskList<> waiters;
+};
+
+/**
+ * Event that coroutines can wait on until it is set
+ */
+class AsyncEvent : public AsyncWaitList {
+public:
+    AsyncEvent(bool set = false) : flag(set) {}
+
+    /**
+     * Check if the event is set
+     */
+    bool isSet() {return this->flag;}
+
+    /**
+     * Wait using co_await until the event is set, does not wait if the event is set already
+     */
+    [[nodiscard]] Awaitable<> wait() {
+        if (this->flag)
+            return {};
+        return {this->waiters};
+    }
+
+    /**
+     * Set the event and resume all waiting coroutines
+     */
+    void set() {
+        this->flag = true;
+        resumeAll();
+    }
+
+    /**
+     * Reset the event so that coroutines wait again
+     */
+    void reset() {this->flag = false;}
+
+protected:
+    bool flag;
+};
+
+/**
+ * Counting semaphore, release() passes the permit directly to the first waiting coroutine
+ */
+class AsyncSemaphore : public AsyncWaitList {
+public:
+    /**
+     * Constructor
+     * @param count initial number of permits
+     */
+    explicit AsyncSemaphore(int count) : count(count) {}
+
+    /**
+     * Get the number of available permits
+     */
+    int available() {return this->count;}
+
+    /**
+     * Try to acquire a permit without waiting
+     * @return true if successful
+     */
+    bool tryAcquire() {
+        if (this->count <= 0)
+            return false;
+        --this->count;
+        return true;
+    }
+
+    /**
+     * Acquire a permit using co_await, waits in FIFO order until a permit is available
+     */
+    [[nodiscard]] Awaitable<> acquire() {
+        if (this->waiters.empty() && tryAcquire())
+            return {};
+        return {this->waiters};
+    }
+
+    /**
+     * Release a permit, resumes the first waiting coroutine which then owns the permit
+     */
+    void release() {
+        if (!this->waiters.empty())
+            this->waiters.doFirst();
+        else
+            ++this->count;
+    }
+
+protected:
+    int count;
+};
+
+/**
+ * Mutex, unlock() passes the lock directly to the first waiting coroutine
+ */
+class AsyncMutex : public AsyncWaitList {
+public:
+    /**
+     * Check if the mutex is locked
+     */
+    bool isLocked() {return this->locked;}
+
+    /**
+     * Try to lock the mutex without waiting
+     * @return true if successful
+     */
+    bool tryLock() {
+        if (this->locked)
+            return false;
+        this->locked = true;
+        return true;
+    }
+
+    /**
+     * Lock the mutex using co_await, waits in FIFO order until the mutex is unlocked
+     */
+    [[nodiscard]] Awaitable<> lock() {
+        if (tryLock())
+            return {};
+        return {this->waiters};
+    }
+
+    /**
+     * Unlock the mutex, resumes the first waiting coroutine which then owns the lock
+     */
+    void unlock() {
+        if (!this->waiters.empty())
+            this->waiters.doFirst();
+        else
+            this->locked = false;
+    }
+
+protected:
+    bool locked = false;
+};
+
+/**
+ * Barrier for a fixed number of coroutines, the last coroutine that arrives resumes the others. The barrier can be
+ * used again for the next phase. Do not combine arrive() with Loop::withTimeout() as a timed out arrival still counts.
+ */
+class AsyncBarrier : public AsyncWaitList {
+public:
+    /**
+     * Constructor
+     * @param count number of coroutines that have to arrive
+     */
+    explicit AsyncBarrier(int count) : count(count) {}
+
+    /**
+     * Arrive at the barrier and wait using co_await until all coroutines have arrived
+     */
+    [[nodiscard]] Awaitable<> arrive() {
+        if (++this->arrived < this->count)
+            return {this->waiters};
+
+        // last coroutine: start the next phase and resume the others
+        this->arrived = 0;
+        resumeAll();
+        return {};
+    }
+
+protected:
+    int count;
+    int arrived = 0;
+};
+
+} // namespace coco
@@ -1,7 +1,52 @@
 #include "Loop.hpp"
+#include <bit>
 
 
 namespace coco {
 
+Loop::Time Loop::coalesce(Time time, Duration slack) {
+	if (slack.value <= 0)
+		return time;
+
+	// round up to a multiple of the granularity, unsigned arithmetic to wrap around
+	unsigned granularity = std::bit_floor(unsigned(slack.value));
+	return Time(int((unsigned(time.value) + granularity - 1) & ~(granularity - 1)));
+}
+
+void Loop::handleYield() {
+	// switch queues so that tasks that yield again get called in the next iteration
+	int index = this->yieldIndex;
+	this->yieldIndex = index ^ 1;
+	this->yieldTasks1[index].doAll();
+	this->yieldTasks2[index].doAll();
+}
+
+
+// Loop::Periodic
+
+Awaitable<CoroutineTimedTask> Loop::Periodic::next() {
+	Time now = this->loop.now();
+	Time time = this->time + this->period;
+	this->time = time;
+	this->missed = 0;
+	if (time < now) {
+		// the coroutine has overrun the tick, count the ticks that have passed after it
+		int count = (now - time).value / this->period.value;
+		if (this->policy == Policy::SKIP) {
+			// continue on the multiples of the period
+			this->missed = count;
+			this->time = time + count * this->period;
+		} else if (this->policy == Policy::DELAY) {
+			// continue one period after the current time
+			this->missed = count;
+			this->time = now;
+		}
+		// Policy::BURST: the next ticks follow immediately until the ticker has caught up
+	}
+	this->missedCount += this->missed;
+
+	// an overrun tick is due immediately
+	return this->loop.sleep(time);
+}
 
 } // namespace coco
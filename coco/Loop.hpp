@@ -1,11 +1,28 @@
 #pragma once
 
+#include <coco/Callback.hpp>
 #include <coco/Coroutine.hpp>
 #include <coco/Time.hpp>
+#include <concepts>
+#include <coroutine>
+#include <type_traits>
 
 
 namespace coco {
 
+/**
+ * Awaitable that can be cancelled while a coroutine is waiting on it, e.g. by Loop::withTimeout(). Either the
+ * awaitable has a cancel() method that returns true if it was still waiting, or it is an intrusive list node such as
+ * Awaitable<> that gets cancelled by removing it from its list.
+ */
+template <typename A>
+concept CancelableAwaitable = requires(A &awaitable) {
+    {awaitable.cancel()} -> std::convertible_to<bool>;
+} || requires(A &awaitable) {
+    {awaitable.inList()} -> std::convertible_to<bool>;
+    awaitable.remove();
+};
+
 /**
  * Main event loop. Subclasses implement the event loop for different target platforms
  */
@@ -32,6 +49,37 @@ public:
      */
     [[nodiscard]] Time virtual now() = 0;
 
+    /**
+     * Get the time that was read from the clock in the current loop iteration. The loop reads the clock after it has
+     * waited for events, before the handlers get called, and again before the sleep tasks get called. Does not read
+     * the clock, therefore the time lags behind now() by the time that the handlers of the current iteration have
+     * been running. Use in handlers that only need the precision of a loop iteration.
+     * @return cached time
+     */
+    [[nodiscard]] Time cachedNow() {return this->cachedTime;}
+
+    /**
+     * Read the clock and update the cached time, e.g. after a long calculation
+     * @return current time
+     */
+    Time refreshNow() {return this->cachedTime = now();}
+
+    /**
+     * Get current time in microseconds with the resolution of the clock of the loop, e.g. for control loops and
+     * protocol timing. Sleep tasks keep millisecond resolution.
+     * @return current time in microseconds since an unspecified point in time
+     */
+    [[nodiscard]] virtual Microseconds<int64_t> nowMicroseconds() {
+        // the default implementation is based on now() and therefore wraps around after 2^32 milliseconds
+        return {int64_t(uint32_t(now().value)) * 1000};
+    }
+
+    /**
+     * Get the resolution of the clock used by nowMicroseconds()
+     * @return resolution in microseconds, at least 1
+     */
+    [[nodiscard]] virtual Microseconds<> resolution() {return {1000};}
+
     /**
      * Suspend execution using co_await until a given time. Only up to TIMER_COUNT coroutines can wait simultaneously.
      * @param time time point
@@ -45,12 +93,227 @@ public:
     [[nodiscard]] Awaitable<CoroutineTimedTask> sleep(Duration duration) {return sleep(now() + duration);}
 
     /**
-     * Yield control to other coroutines. Can be used to do longer processing in a cooperative way.
+     * Suspend execution using co_await until a given time with a slack. The loop may resume up to slack later so that
+     * timers whose windows overlap get handled in one wakeup.
+     * @param time time point
+     * @param slack maximum delay
+     */
+    [[nodiscard]] Awaitable<CoroutineTimedTask> sleep(Time time, Duration slack) {return sleep(coalesce(time, slack));}
+
+    /**
+     * Suspend execution using co_await for a given duration with a slack. The loop may resume up to slack later so
+     * that timers whose windows overlap get handled in one wakeup.
+     * @param duration duration
+     * @param slack maximum delay
+     */
+    [[nodiscard]] Awaitable<CoroutineTimedTask> sleep(Duration duration, Duration slack) {
+        return sleep(coalesce(now() + duration, slack));
+    }
+
+    /**
+     * Yield control to other coroutines. Can be used to do longer processing in a cooperative way. The coroutine gets
+     * resumed in FIFO order in the next iteration of the loop which does not block while coroutines are waiting.
+     */
+    [[nodiscard]] Awaitable<> yield() {return {this->yieldTasks2[this->yieldIndex]};}
+
+    /**
+     * Call a task in the next iteration of the loop. The tasks get called in FIFO order before the coroutines waiting
+     * on yield() get resumed
+     * @param task task to call
      */
-    [[nodiscard]] virtual Awaitable<CoroutineTimedTask> yield() {return sleep(now());}
+    void invoke(Task<Callback> &task) {
+        task.cancel();
+        this->yieldTasks1[this->yieldIndex].add(task);
+    }
+
+    /**
+     * Periodic timer that ticks on absolute multiples of the period so that the runtime of the coroutine does not
+     * cause a drift. Usage:
+     *
+     * auto ticker = loop.periodic(100ms);
+     * while (true) {
+     *     co_await ticker.next();
+     *     ...
+     * }
+     */
+    class Periodic {
+    public:
+        /**
+         * What to do when the coroutine has overrun one or more ticks
+         */
+        enum class Policy {
+            /// tick once immediately, then continue on the next multiple of the period, the overrun ticks are missed
+            SKIP,
+
+            /// tick immediately for each overrun tick until the ticker has caught up, no tick is missed
+            BURST,
+
+            /// tick once immediately, then continue one period after the current time, the overrun ticks are missed
+            DELAY
+        };
+
+        /**
+         * Constructor, the first tick is one period after the current time
+         * @param loop event loop
+         * @param period period, a period of zero or less gets clamped to 1ms
+         * @param policy policy for overrun ticks
+         */
+        Periodic(Loop &loop, Duration period, Policy policy = Policy::SKIP)
+            : loop(loop), period(period.value > 0 ? period : Duration{1}), policy(policy), time(loop.now()) {}
+
+        /**
+         * Suspend execution using co_await until the next tick
+         */
+        [[nodiscard]] Awaitable<CoroutineTimedTask> next();
+
+        // number of ticks that were missed before the current tick
+        int missed = 0;
+
+        // total number of missed ticks
+        int missedCount = 0;
+
+    protected:
+        Loop &loop;
+        Duration period;
+        Policy policy;
+
+        // time of the current tick
+        Time time;
+    };
+
+    /**
+     * Create a periodic timer, the first tick is one period after the current time
+     * @param period period, a period of zero or less gets clamped to 1ms
+     * @param policy policy for overrun ticks
+     */
+    [[nodiscard]] Periodic periodic(Duration period, Periodic::Policy policy = Periodic::Policy::SKIP) {
+        return {*this, period, policy};
+    }
+
+    /**
+     * Awaitable that waits for an awaitable of the loop or a timeout, whichever comes first. The one that did not
+     * resume the coroutine is still waiting and gets cancelled, therefore nothing gets allocated. co_await returns
+     * true if the awaitable has completed and false on timeout.
+     * @tparam A awaitable type that can be cancelled, e.g. Awaitable<>
+     */
+    template <CancelableAwaitable A>
+    class Timeout {
+    public:
+        Timeout(A &awaitable, Loop &loop, Time time) : awaitable(awaitable), timer(loop.sleep(time)) {}
+
+        bool await_ready() {
+            return this->awaitable.await_ready();
+        }
+
+        template <typename P>
+        bool await_suspend(std::coroutine_handle<P> handle) {
+            // if the awaitable completes right away, the coroutine does not get suspended
+            if (!suspend(this->awaitable, handle))
+                return false;
+            suspend(this->timer, handle);
+            return true;
+        }
+
+        bool await_resume() {
+            // timeout if the awaitable is still waiting
+            if (cancel(this->awaitable))
+                return false;
+
+            // completed: cancel the timer
+            cancel(this->timer);
+            this->awaitable.await_resume();
+            return true;
+        }
+
+    protected:
+        // cancel an awaitable if it is still waiting, returns true if it was waiting
+        template <typename B>
+        static bool cancel(B &awaitable) {
+            if constexpr (requires {{awaitable.cancel()} -> std::convertible_to<bool>;}) {
+                return awaitable.cancel();
+            } else {
+                if (!awaitable.inList())
+                    return false;
+                awaitable.remove();
+                return true;
+            }
+        }
+
+        template <typename B, typename P>
+        static bool suspend(B &awaitable, std::coroutine_handle<P> handle) {
+            if constexpr (std::is_void_v<decltype(awaitable.await_suspend(handle))>) {
+                awaitable.await_suspend(handle);
+                return true;
+            } else {
+                return awaitable.await_suspend(handle);
+            }
+        }
+
+        A &awaitable;
+        Awaitable<CoroutineTimedTask> timer;
+    };
+
+    /**
+     * Wait for an awaitable of the loop or a timeout using co_await, whichever comes first. Usage:
+     *
+     * if (!co_await loop.withTimeout(operation.read(fd, data, size), 50ms)) {
+     *     // timeout
+     * }
+     *
+     * @param awaitable awaitable that can be cancelled, lives until the end of the co_await expression
+     * @param duration timeout duration
+     * @return awaitable that yields true if the awaitable has completed and false on timeout
+     */
+    template <typename A> requires CancelableAwaitable<std::remove_reference_t<A>>
+    [[nodiscard]] Timeout<std::remove_reference_t<A>> withTimeout(A &&awaitable, Duration duration) {
+        return {awaitable, *this, now() + duration};
+    }
 
 
     bool exitFlag = false;
+
+    // number of timers that fired in the same wakeup as another timer, i.e. the timers per wakeup minus one
+    int coalescedCount = 0;
+
+protected:
+    // time that was read from the clock in the current loop iteration
+    Time cachedTime = Time(0);
+
+    /**
+     * Round a time up to a multiple of the largest power of two that is not greater than the slack. Timers whose
+     * windows overlap end up at the same time and get handled in one wakeup.
+     * @param time time point
+     * @param slack maximum delay
+     * @return coalesced time
+     */
+    Time coalesce(Time time, Duration slack);
+
+    /**
+     * Count the timers that fired in the same wakeup as another timer
+     * @param count number of timers that fired in the current wakeup
+     */
+    void countCoalesced(int count) {
+        if (count > 1)
+            this->coalescedCount += count - 1;
+    }
+
+    /**
+     * Check if tasks or coroutines wait on invoke() or yield(), the loop must not block then
+     */
+    bool hasYieldTasks() {
+        return !this->yieldTasks1[this->yieldIndex].empty() || !this->yieldTasks2[this->yieldIndex].empty();
+    }
+
+    /**
+     * Call the tasks and resume the coroutines that wait on invoke() or yield(). Tasks and coroutines that yield again
+     * go into the other queue and get called in the next iteration so that the loop does not starve
+     */
+    void handleYield();
+
+    // two queues for yield tasks, new tasks go into the queue at yieldIndex
+    TaskList<Task<Callback>> yieldTasks1[2];
+    CoroutineTaskList<> yieldTasks2[2];
+    int yieldIndex = 0;
 };
 
 } // namespace coco
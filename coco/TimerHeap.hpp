@@ -0,0 +1,194 @@
+#pragma once
+
+#include <coco/TimerList.hpp>
+#include <cstdint>
+
+
+namespace coco {
+
+/**
+ * Timer store that hashes timed tasks into N sorted slot lists and orders the slots in an array backed d-ary heap
+ * keyed by the time of their first task. Each slot knows its position in the heap, therefore a slot whose first task
+ * changes is moved in O(log n) and the first task is found in O(1). All tasks of the same time are in the same slot,
+ * therefore calling the tasks of the top slot up to its key calls the tasks in the same order as TimerList.
+ * Tasks that are cancelled only make the key of their slot too early, which gets repaired lazily when the slot
+ * reaches the top of the heap. Tasks that are added to the list returned by list() (e.g. by an Awaitable that may be
+ * created long before the coroutine suspends) wait in a pending list and get moved into their slot when the first
+ * time is requested or the due tasks get called.
+ * @tparam L list type, e.g. TimedTaskList<Callback> or CoroutineTimedTaskList
+ * @tparam N number of slots, a power of two
+ * @tparam D number of children of each heap node
+ */
+template <typename L, int N = 256, int D = 4>
+class TimerHeap {
+    static_assert(N > 0 && N <= 0x8000 && (N & (N - 1)) == 0, "N must be a power of two");
+    static_assert(D >= 2, "D must be at least 2");
+public:
+    using Time = TimeMilliseconds<>;
+
+    TimerHeap() {
+        for (int i = 0; i < N; ++i)
+            this->positions[i] = NONE;
+    }
+
+    /**
+     * Get the list into which a task for the given time has to be added, e.g. for an Awaitable
+     * @param time time of the task
+     * @return list
+     */
+    L &list(Time time) {return this->pending;}
+
+    /**
+     * Add a task, the time of the task has to be set
+     * @param task task to add
+     */
+    template <typename T>
+    void add(T &task) {
+        Time time = task.time;
+        int slot = time.value & (N - 1);
+        int i = this->positions[slot];
+        if (i == NONE) {
+            // insert slot into the heap
+            i = this->count++;
+            this->heap[i] = {time, uint16_t(slot)};
+            this->positions[slot] = i;
+            siftUp(i);
+        } else if (time < this->heap[i].time) {
+            // the task becomes the first task of the slot
+            this->heap[i].time = time;
+            siftUp(i);
+        }
+        this->slots[slot].add(task);
+    }
+
+    /**
+     * Check if the timer store is empty
+     */
+    bool empty() {
+        flush();
+        repair();
+        return this->count == 0;
+    }
+
+    /**
+     * Get time of the first task
+     * @param defaultTime time to return if there is no task or the first task is after this time
+     * @return time of the first task or defaultTime
+     */
+    Time getFirstTime(Time defaultTime) {
+        flush();
+        repair();
+        return this->count > 0 && this->heap[0].time < defaultTime ? this->heap[0].time : defaultTime;
+    }
+
+    /**
+     * Call all tasks that are due until the given time
+     * @param time current time
+     * @return number of called tasks
+     */
+    int doUntil(Time time) {
+        int count = 0;
+        while (true) {
+            // called tasks may add tasks to the pending list
+            flush();
+            repair();
+            if (this->count == 0 || this->heap[0].time > time)
+                break;
+
+            // call the tasks of the first time, the slot may also contain tasks of later times
+            count += callDueTasks(this->slots[this->heap[0].slot], this->heap[0].time);
+        }
+        return count;
+    }
+
+protected:
+    static constexpr uint16_t NONE = 0xffff;
+
+    // move the pending tasks into their slots
+    void flush() {
+        while (!this->pending.empty()) {
+            auto &task = *this->pending.begin();
+            task.remove();
+            add(task);
+        }
+    }
+
+    // update the key of the top slot to the time of its first task until the key of the top slot is correct
+    void repair() {
+        while (this->count > 0) {
+            auto &entry = this->heap[0];
+            auto &list = this->slots[entry.slot];
+            if (list.empty()) {
+                // remove empty slot from the heap
+                this->positions[entry.slot] = NONE;
+                --this->count;
+                if (this->count > 0) {
+                    this->heap[0] = this->heap[this->count];
+                    this->positions[this->heap[0].slot] = 0;
+                    siftDown(0);
+                }
+            } else {
+                Time time = list.begin()->time;
+                if (time == entry.time)
+                    break;
+                entry.time = time;
+                siftDown(0);
+            }
+        }
+    }
+
+    void siftUp(int i) {
+        auto entry = this->heap[i];
+        while (i > 0) {
+            int parent = (i - 1) / D;
+            if (!(entry.time < this->heap[parent].time))
+                break;
+            this->heap[i] = this->heap[parent];
+            this->positions[this->heap[i].slot] = i;
+            i = parent;
+        }
+        this->heap[i] = entry;
+        this->positions[entry.slot] = i;
+    }
+
+    void siftDown(int i) {
+        auto entry = this->heap[i];
+        while (true) {
+            // find the child with the earliest time
+            int first = i * D + 1;
+            if (first >= this->count)
+                break;
+            int end = first + D < this->count ? first + D : this->count;
+            int child = first;
+            for (int j = first + 1; j < end; ++j) {
+                if (this->heap[j].time < this->heap[child].time)
+                    child = j;
+            }
+            if (!(this->heap[child].time < entry.time))
+                break;
+            this->heap[i] = this->heap[child];
+            this->positions[this->heap[i].slot] = i;
+            i = child;
+        }
+        this->heap[i] = entry;
+        this->positions[entry.slot] = i;
+    }
+
+    // heap of slots ordered by the time of their first task, stored contiguously
+    struct Entry {
+        Time time;
+        uint16_t slot;
+    };
+    Entry heap[N];
+    int count = 0;
+
+    // position of each slot in the heap or NONE if the slot is not in the heap
+    uint16_t positions[N];
+
+    L slots[N];
+
+    // tasks that were added to the list returned by list() and are not in their slot yet
+    L pending;
+};
+
+} // namespace coco
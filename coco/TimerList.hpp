@@ -0,0 +1,74 @@
+#pragma once
+
+#include <coco/Time.hpp>
+
+
+namespace coco {
+
+/**
+ * Call all tasks of a sorted list that are due until the given time
+ * @param tasks sorted list of timed tasks
+ * @param time current time
+ * @return number of tasks that were due
+ */
+template <typename L>
+int callDueTasks(L &tasks, TimeMilliseconds<> time) {
+    // count the due tasks at the front of the list before they get called and removed
+    int count = 0;
+    for (auto &task : tasks) {
+        if (task.time > time)
+            break;
+        ++count;
+    }
+    tasks.doUntil(time);
+    return count;
+}
+
+/**
+ * Timer store that keeps all timed tasks in one sorted list. Insertion is O(n), cancellation is O(1) and the first
+ * task is found in O(1).
+ * @tparam L list type, e.g. TimedTaskList<Callback> or CoroutineTimedTaskList
+ */
+template <typename L>
+class TimerList {
+public:
+    using Time = TimeMilliseconds<>;
+
+    /**
+     * Get the list into which a task for the given time has to be added, e.g. for an Awaitable
+     * @param time time of the task
+     * @return list
+     */
+    L &list(Time time) {return this->tasks;}
+
+    /**
+     * Add a task, the time of the task has to be set
+     * @param task task to add
+     */
+    template <typename T>
+    void add(T &task) {this->tasks.add(task);}
+
+    /**
+     * Check if the timer store is empty
+     */
+    bool empty() {return this->tasks.empty();}
+
+    /**
+     * Get time of the first task
+     * @param defaultTime time to return if there is no task or the first task is after this time
+     * @return time of the first task or defaultTime
+     */
+    Time getFirstTime(Time defaultTime) {return this->tasks.getFirstTime(defaultTime);}
+
+    /**
+     * Call all tasks that are due until the given time
+     * @param time current time
+     * @return number of called tasks
+     */
+    int doUntil(Time time) {return callDueTasks(this->tasks, time);}
+
+protected:
+    L tasks;
+};
+
+} // namespace coco
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <coco/TimerHeap.hpp>
+#include <coco/TimerList.hpp>
+#include <coco/TimerWheel.hpp>
+
+
+namespace coco {
+
+/**
+ * Timer store of the loops, selected at compile time using the CMake variable COCO_LOOP_TIMERS (conan option
+ * timers): LIST uses TimerList (default), WHEEL uses TimerWheel, HEAP uses TimerHeap
+ * @tparam L list type, e.g. TimedTaskList<Callback> or CoroutineTimedTaskList
+ */
+#if defined(COCO_LOOP_TIMERS_WHEEL)
+template <typename L>
+using TimerStore = TimerWheel<L>;
+#elif defined(COCO_LOOP_TIMERS_HEAP)
+template <typename L>
+using TimerStore = TimerHeap<L>;
+#else
+template <typename L>
+using TimerStore = TimerList<L>;
+#endif
+
+} // namespace coco
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <coco/IntrusiveList.hpp>
+#include <coco/TimerList.hpp>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+
+namespace coco {
+
+/**
+ * Hierarchical timer store. Level 0 is a wheel of N slots with a granularity of one millisecond, each upper level is
+ * a wheel of 64 slots whose granularity is the span of the level below, therefore the levels cover the whole 32 bit
+ * time range. A task goes into the lowest level on which its time and the current time agree in all higher bits and
+ * gets appended to its slot without sorting, therefore insertion and cancellation are O(1). When the current time
+ * enters the span of an upper slot, its tasks cascade down to the lower levels. All tasks of a slot of level 0 have
+ * the same time and get called in the order in which they were added, like tasks of the same time in TimerList.
+ * The next occupied slot is found by scanning a bitmap of occupied slots and its time is cached until tasks get due.
+ * Tasks that are added with a time before the current time are kept in a sorted overdue list.
+ * Tasks that are added to the list returned by list() (e.g. by an Awaitable that may be created long before the
+ * coroutine suspends) wait in a pending list and get moved into their slot when the first time is requested or the
+ * due tasks get called.
+ * @tparam L list type, e.g. TimedTaskList<Callback> or CoroutineTimedTaskList
+ * @tparam N number of slots of level 0, a power of two, at least 64
+ */
+template <typename L, int N = 1024>
+class TimerWheel {
+    static_assert(N >= 64 && (N & (N - 1)) == 0, "N must be a power of two and at least 64");
+public:
+    using Time = TimeMilliseconds<>;
+
+    /**
+     * Get the list into which a task for the given time has to be added, e.g. for an Awaitable
+     * @param time time of the task
+     * @return list
+     */
+    L &list(Time time) {return this->pending;}
+
+    /**
+     * Add a task, the time of the task has to be set
+     * @param task task to add
+     */
+    template <typename T>
+    void add(T &task) {
+        // the slots are relative to the current time which is known after the first call to doUntil()
+        if (!this->started) {
+            this->pending.add(task);
+            return;
+        }
+        place(task);
+    }
+
+    /**
+     * Check if the timer store is empty
+     */
+    bool empty() {
+        if (!this->started)
+            return this->pending.empty();
+        flush();
+        if (!this->overdue.empty())
+            return false;
+        return scan(0, SLOT_COUNT) == -1;
+    }
+
+    /**
+     * Get time of the first task
+     * @param defaultTime time to return if there is no task or the first task is after this time
+     * @return time of the first task or defaultTime, may be too early when the first task is on an upper level which
+     * only causes an early wakeup of the loop
+     */
+    Time getFirstTime(Time defaultTime) {
+        if (!this->started)
+            return this->pending.getFirstTime(defaultTime);
+        flush();
+        if (!this->firstValid)
+            findFirst();
+        return this->firstFound && this->first < defaultTime ? this->first : defaultTime;
+    }
+
+    /**
+     * Call all tasks that are due until the given time
+     * @param time current time
+     * @return number of called tasks
+     */
+    int doUntil(Time time) {
+        // the wheel starts at the time of the first call
+        if (!this->started) {
+            this->current = time;
+            this->started = true;
+        }
+
+        // nothing to do if the first task is not due yet
+        flush();
+        if (this->firstValid && (!this->firstFound || time < this->first)) {
+            if (!(time < this->current))
+                advance(time + 1ms);
+            return 0;
+        }
+
+        int count = 0;
+        while (true) {
+            // called tasks may add tasks that are pending or overdue already
+            flush();
+            count += callDueTasks(this->overdue, time);
+
+            // visit the next occupied slot
+            int level;
+            int slot = findNext(level);
+            if (slot == -1)
+                break;
+            Time start = getStart(level, slot);
+            if (start > time)
+                break;
+            if (level == 0) {
+                // tasks that get added with the time of the slot by the called tasks get called in the same visit
+                this->current = start;
+                count += callDueTasks(this->slots[slot], start);
+                advance(start + 1ms);
+            } else {
+                // cascade the tasks of the upper slot down to the lower levels
+                advance(start);
+            }
+        }
+
+        // tasks that get added for a time up to the given time are overdue
+        if (!(time < this->current))
+            advance(time + 1ms);
+        this->firstValid = false;
+        return count;
+    }
+
+protected:
+    static constexpr int BITS0 = std::countr_zero(unsigned(N));
+    static constexpr int LEVELS = 2 + (31 - BITS0) / 6;
+    static constexpr int SLOT_COUNT = N + (LEVELS - 1) * 64;
+
+    // number of the lowest time bit that selects the slot on a level
+    static constexpr int getShift(int level) {return level == 0 ? 0 : BITS0 + (level - 1) * 6;}
+
+    // number of time bits covered by a whole level
+    static constexpr int getSpan(int level) {return level == 0 ? BITS0 : getShift(level) + 6;}
+
+    // index of the first slot of a level
+    static constexpr int getBase(int level) {return level == 0 ? 0 : N + (level - 1) * 64;}
+
+    // slot of a time on a level
+    static int getSlot(int level, Time time) {
+        int mask = level == 0 ? N - 1 : 63;
+        return getBase(level) + int((uint32_t(time.value) >> getShift(level)) & mask);
+    }
+
+    // start time of a slot on a level in the current revolution of the level above
+    Time getStart(int level, int slot) {
+        uint64_t high = uint64_t(uint32_t(this->current.value)) & ~((uint64_t(1) << getSpan(level)) - 1);
+        return Time(int(uint32_t(high | (uint64_t(slot - getBase(level)) << getShift(level)))));
+    }
+
+    // append a task to a slot without sorting
+    template <typename T>
+    static void append(IntrusiveList<T> &list, std::type_identity_t<T> &task) {list.add(task);}
+
+    // put a task into the slot of the lowest level on which its time agrees with the current time in all higher bits
+    template <typename T>
+    void place(T &task) {
+        // update the cached first time
+        Time time = task.time;
+        if (this->firstValid && (!this->firstFound || time < this->first)) {
+            this->first = time;
+            this->firstFound = true;
+        }
+
+        if (time < this->current) {
+            this->overdue.add(task);
+            return;
+        }
+        uint32_t diff = uint32_t(time.value) ^ uint32_t(this->current.value);
+        int level = diff >> BITS0 == 0 ? 0 : 1 + (std::bit_width(diff) - 1 - BITS0) / 6;
+        int slot = getSlot(level, time);
+        this->occupied[slot >> 6] |= uint64_t(1) << (slot & 63);
+        append(this->slots[slot], task);
+    }
+
+    // move the pending tasks into their slots
+    void flush() {
+        while (!this->pending.empty()) {
+            auto &task = *this->pending.begin();
+            task.remove();
+            place(task);
+        }
+    }
+
+    // find the first occupied slot in the range [begin, end), returns -1 if there is none
+    int scan(int begin, int end) {
+        for (int i = begin; i < end;) {
+            int word = i >> 6;
+            int wordEnd = (word + 1) << 6;
+            uint64_t bits = this->occupied[word] & (~uint64_t(0) << (i & 63));
+            if (end < wordEnd)
+                bits &= ~uint64_t(0) >> (wordEnd - end);
+            while (bits != 0) {
+                int slot = (word << 6) + std::countr_zero(bits);
+                bits &= bits - 1;
+                if (!this->slots[slot].empty())
+                    return slot;
+
+                // clear bit of slot whose tasks were cancelled
+                this->occupied[word] &= ~(uint64_t(1) << (slot & 63));
+            }
+            i = wordEnd;
+        }
+        return -1;
+    }
+
+    // find the first occupied slot at or after the current time, returns -1 if there is none
+    int findNext(int &level) {
+        // level 0 from the current time, the upper levels after the slot of the current time which is empty
+        for (level = 0; level < LEVELS - 1; ++level) {
+            int begin = getSlot(level, this->current) + (level == 0 ? 0 : 1);
+            int slot = scan(begin, getBase(level + 1));
+            if (slot != -1)
+                return slot;
+        }
+
+        // the top level wraps around
+        int begin = getSlot(level, this->current) + 1;
+        int slot = scan(begin, SLOT_COUNT);
+        if (slot == -1)
+            slot = scan(getBase(level), begin - 1);
+        return slot;
+    }
+
+    // find the time of the first task, overdue tasks are before all tasks in the slots
+    void findFirst() {
+        this->firstValid = true;
+        this->firstFound = true;
+        if (!this->overdue.empty()) {
+            this->first = this->overdue.begin()->time;
+            return;
+        }
+        int level;
+        int slot = findNext(level);
+        if (slot == -1)
+            this->firstFound = false;
+        else
+            this->first = getStart(level, slot);
+    }
+
+    // advance the current time, the tasks in the upper slots of the new current time cascade down
+    void advance(Time time) {
+        this->current = time;
+        for (int level = LEVELS - 1; level >= 1; --level) {
+            int slot = getSlot(level, time);
+            uint64_t bit = uint64_t(1) << (slot & 63);
+            if (this->occupied[slot >> 6] & bit) {
+                this->occupied[slot >> 6] &= ~bit;
+                auto &list = this->slots[slot];
+                while (!list.empty()) {
+                    auto &task = *list.begin();
+                    task.remove();
+                    place(task);
+                }
+            }
+        }
+    }
+
+    // time up to which tasks have been called (exclusive), valid after the first call to doUntil()
+    Time current = Time(0);
+    bool started = false;
+
+    // cached time of the first task, may be too early when the first task was cancelled or is on an upper level
+    Time first;
+    bool firstFound = false;
+    bool firstValid = false;
+
+    // bitmap of slots that may contain tasks
+    uint64_t occupied[SLOT_COUNT / 64] = {};
+
+    // slots of all levels, level 0 first
+    L slots[SLOT_COUNT];
+
+    // tasks whose time is before the current time
+    L overdue;
+
+    // tasks that were added to the list returned by list() and are not in their slot yet
+    L pending;
+};
+
+} // namespace coco
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+namespace coco {
+
+/**
+ * Bounded lock-free work-stealing deque (Chase-Lev). The owner thread pushes and pops at the bottom, other threads
+ * steal from the top. The capacity is fixed, therefore nothing gets allocated and push() fails when the deque is
+ * full.
+ * Reference: N. M. Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP 2013
+ * @tparam T element type, must be trivially copyable and fit into an atomic, e.g. a pointer
+ * @tparam N capacity, a power of two
+ */
+template <typename T, int N = 1024>
+class WorkStealingDeque {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+public:
+
+    /**
+     * Push an element at the bottom, only called by the owner
+     * @param element element to push
+     * @return true if successful, false if the deque is full
+     */
+    bool push(T element) {
+        int64_t b = this->bottom.load(std::memory_order_relaxed);
+        int64_t t = this->top.load(std::memory_order_acquire);
+        if (b - t >= N)
+            return false;
+        this->buffer[b & MASK].store(element, std::memory_order_relaxed);
+
+        // release the element to thieves that read bottom with acquire
+        this->bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Pop an element from the bottom, only called by the owner
+     * @param element element that was popped
+     * @return true if successful, false if the deque is empty or the last element was stolen
+     */
+    bool pop(T &element) {
+        int64_t b = this->bottom.load(std::memory_order_relaxed) - 1;
+        this->bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = this->top.load(std::memory_order_relaxed);
+        if (t > b) {
+            // empty
+            this->bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        element = this->buffer[b & MASK].load(std::memory_order_relaxed);
+        if (t == b) {
+            // last element: race against thieves
+            bool success = this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                std::memory_order_relaxed);
+            this->bottom.store(b + 1, std::memory_order_relaxed);
+            return success;
+        }
+        return true;
+    }
+
+    /**
+     * Steal an element from the top, can be called by any thread
+     * @param element element that was stolen
+     * @return true if successful, false if the deque is empty or another thread was faster
+     */
+    bool steal(T &element) {
+        int64_t t = this->top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = this->bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+        element = this->buffer[t & MASK].load(std::memory_order_relaxed);
+        return this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    /**
+     * Get the approximate number of elements, can be called by any thread
+     */
+    int size() {
+        int64_t b = this->bottom.load(std::memory_order_relaxed);
+        int64_t t = this->top.load(std::memory_order_relaxed);
+        return b > t ? int(b - t) : 0;
+    }
+
+protected:
+    static constexpr int64_t MASK = N - 1;
+
+    // thieves take from the top, the owner works at the bottom, on separate cache lines to avoid false sharing
+    alignas(64) std::atomic<int64_t> top = 0;
+    alignas(64) std::atomic<int64_t> bottom = 0;
+    alignas(64) std::atomic<T> buffer[N];
+};
+
+} // namespace coco
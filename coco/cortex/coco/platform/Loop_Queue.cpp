@@ -3,4 +3,30 @@
 
 namespace coco {
 
+bool Loop_Queue::handleQueue() {
+    int budget = this->handlerBudget;
+    int priority = PRIORITY_COUNT - 1;
+    while (priority >= 0) {
+        Handler *handler = this->handlerQueues[priority].pop();
+        if (handler == nullptr) {
+            // continue with the next lower priority
+            --priority;
+            continue;
+        }
+        handler->handle();
+
+        // stop when the budget is used up, the remaining handlers get called in the next iteration
+        if (--budget == 0) {
+            ++this->budgetHitCount;
+            this->handlerPending = true;
+            return true;
+        }
+
+        // an interrupt may have pushed a handler of higher priority in the meantime
+        priority = PRIORITY_COUNT - 1;
+    }
+    this->handlerPending = false;
+    return false;
+}
+
 } // namespace coco
@@ -2,8 +2,11 @@
 
 #include <coco/Loop.hpp>
 #include <coco/Callback.hpp>
+#include <coco/TimerStore.hpp>
 #include <coco/IntrusiveMpscQueue.hpp>
 #include <coco/platform/platform.hpp>
+#include <algorithm>
+#include <cassert>
 
 
 namespace coco {
@@ -20,6 +23,7 @@ namespace coco {
  */
 class Loop_Queue : public Loop {
 public:
+    using Loop::invoke;
 
     void invoke(TimedTask<Callback> &task, Time time) {
         task.cancelAndSet(time);
@@ -36,6 +40,20 @@ public:
         this->sleepTasks1.add(task);
     }
 
+    /**
+     * Call a task at a given time with a slack. The loop may call the task up to slack later so that timers whose
+     * windows overlap get handled in one wakeup.
+     */
+    void invoke(TimedTask<Callback> &task, Time time, Duration slack) {
+        task.cancelAndSet(coalesce(time, slack));
+        this->sleepTasks1.add(task);
+    }
+
+    void invoke(TimedTask<Callback> &task, Duration duration, Duration slack) {
+        task.cancelAndSet(coalesce(now() + duration, slack));
+        this->sleepTasks1.add(task);
+    }
+
     /**
      * Event handler that handles finished device operations
      */
@@ -45,26 +63,55 @@ public:
         virtual void handle() = 0;
     };
 
+    /**
+     * Number of priority levels of the handler queue
+     */
+    static constexpr int PRIORITY_COUNT = 4;
+
     /**
      * Push a handler for a finished device operation onto the handler queue so that the main application gets
      * notified. Can be called from the interrupt service routine of the device e.g. when a read or write operation
-     * has finished.
+     * has finished. Handlers of higher priority get called first, e.g. for a high-rate UART receiver.
+     * @param handler handler to push
+     * @param priority priority from 0 (lowest) to PRIORITY_COUNT - 1 (highest), gets clamped to this range in release
+     * builds
      */
-    void push(Handler &handler) {
-        this->handlerQueue.push(handler);
+    void push(Handler &handler, int priority = 0) {
+        // an invalid priority must not index outside of the queues, also when called from an interrupt service routine
+        assert(priority >= 0 && priority < PRIORITY_COUNT);
+        priority = std::clamp(priority, 0, PRIORITY_COUNT - 1);
+        this->handlerQueues[priority].push(handler);
 
         // set event flag so that the next __WFE() does not sleep as there are new elements in the handler queue
         __SEV();
     }
 
+
+    // maximum number of handlers that get called in one iteration of the loop so that an interrupt storm can't
+    // starve the timers, 0 for no limit
+    int handlerBudget = 0;
+
+    // number of iterations in which the handler budget was hit
+    int budgetHitCount = 0;
+
 protected:
+    /**
+     * Call the handlers of finished device operations in strict priority order, at most handlerBudget handlers
+     * @return true if the budget was hit and handlers may be left in the queue
+     */
+    bool handleQueue();
+
 
     // sleep tasks
-    TimedTaskList<Callback> sleepTasks1;
-    CoroutineTimedTaskList sleepTasks2;
+    TimerStore<TimedTaskList<Callback>> sleepTasks1;
+    TimerStore<CoroutineTimedTaskList> sleepTasks2;
+
+    // handlers for finished device operations, one lock-free queue per priority
+    IntrusiveMpscQueue<Handler> handlerQueues[PRIORITY_COUNT];
 
-    // handlers for finished device operations
-    IntrusiveMpscQueue<Handler> handlerQueue;
+    // set when the handler budget was hit, the loop must not wait for an event then as the event flag set by push()
+    // was already consumed
+    bool handlerPending = false;
 };
 
 } // namespace coco
@@ -28,7 +28,7 @@ void Loop_SysTick::run() {
         // wait for event if sleep time has not yet passed
         // see http://infocenter.arm.com/help/index.jsp?topic=/com.arm.doc.dai0321a/BIHICBGB.html
 #ifndef NRF52
-        if (this->wait) {
+        if (this->wait && !hasYieldTasks() && !this->handlerPending) {
             // time when the current SysTick interval ends
             Time endTime = Time(this->endTime);
 
@@ -46,21 +46,52 @@ void Loop_SysTick::run() {
         }
 #endif
 
-        // call all handlers
-        Handler *handler;
-        while ((handler = this->handlerQueue.pop()) != nullptr) {
-            handler->handle();
-        }
+        // call handlers of finished device operations within the handler budget
+        handleQueue();
+
+        // resume coroutines waiting on yield() and activate yield handlers
+        handleYield();
 
         // resume coroutines waiting on sleep()
-        auto currentTime = now();
-        this->sleepTasks1.doUntil(currentTime);
-        this->sleepTasks2.doUntil(currentTime);
+        auto currentTime = refreshNow();
+        int count = this->sleepTasks1.doUntil(currentTime);
+        count += this->sleepTasks2.doUntil(currentTime);
+        countCoalesced(count);
     }
     this->exitFlag = false;
 }
 
 Loop::Time Loop_SysTick::now() {
+    uint32_t counter = readCounter();
+    return Time(this->endTime - (counter == 0 ? this->interval : counter / this->khz));
+}
+
+Microseconds<int64_t> Loop_SysTick::nowMicroseconds() {
+    uint32_t counter = readCounter();
+
+    // extend the end time to 64 bit, read again if the SysTick interrupt has advanced it in between
+    uint32_t high;
+    uint32_t low;
+    do {
+        high = this->endTimeHigh;
+        low = this->endTime;
+    } while (high != this->endTimeHigh);
+    int64_t endTime = int64_t((uint64_t(high) << 32) | low) * 1000;
+
+    // the counter counts down with khz ticks per millisecond
+    return {endTime - (counter == 0 ? int64_t(this->interval) * 1000 : int64_t(counter) * 1000 / this->khz)};
+}
+
+Microseconds<> Loop_SysTick::resolution() {
+    int us = int(1000 / this->khz);
+    return {us > 1 ? us : 1};
+}
+
+Awaitable<CoroutineTimedTask> Loop_SysTick::sleep(Time time) {
+    return {this->sleepTasks2.list(time), time};
+}
+
+uint32_t Loop_SysTick::readCounter() {
     uint32_t counter = SysTick->VAL;
 
     // check for count flag when in interrupt-less mode
@@ -69,14 +100,9 @@ Loop::Time Loop_SysTick::now() {
         counter = SysTick->VAL;
 
         // advance base time
-        this->endTime = this->endTime + this->interval;
+        advance();
     }
-
-    return Time(this->endTime - (counter == 0 ? this->interval : counter / this->khz));
-}
-
-Awaitable<CoroutineTimedTask> Loop_SysTick::sleep(Time time) {
-    return {this->sleepTasks2, time};
+    return counter;
 }
 
 } // namespace coco
@@ -76,6 +76,8 @@ public:
 
     void run() override;
     [[nodiscard]] Time now() override;
+    [[nodiscard]] Microseconds<int64_t> nowMicroseconds() override;
+    [[nodiscard]] Microseconds<> resolution() override;
     [[nodiscard]] Awaitable<CoroutineTimedTask> sleep(Time time) override;
     using Loop::sleep;
 
@@ -83,13 +85,24 @@ public:
      * Call from SysTick_Handler interrupt when Mode::INTERRUPT or Mode::WAIT is used
      */
     void SysTick_Handler() {
-        this->endTime = this->endTime + this->interval;
+        advance();
 
         // set event flag so that the next __WFE() does not sleep as time has incremented
         __SEV();
     }
 
 protected:
+    // read the SysTick counter and advance the end time when the counter has wrapped in interrupt-less mode
+    uint32_t readCounter();
+
+    // advance the end time by one interval
+    void advance() {
+        uint32_t endTime = this->endTime + this->interval;
+        if (endTime < this->interval)
+            this->endTimeHigh = this->endTimeHigh + 1;
+        this->endTime = endTime;
+    }
+
     uint32_t khz;
     bool wait;
 
@@ -99,12 +112,8 @@ protected:
     // end time of the current SysTick interval
     std::atomic<uint32_t> endTime;
 
-    // sleep tasks
-    TimedTaskList<Callback> sleepTasks1;
-    CoroutineTimedTaskList sleepTasks2;
-
-    // handlers for finished device operations
-    IntrusiveMpscQueue<Handler> handlerQueue;
+    // number of wrap arounds of the end time, extends it to 64 bit for nowMicroseconds()
+    std::atomic<uint32_t> endTimeHigh = 0;
 };
 
 } // namespace coco
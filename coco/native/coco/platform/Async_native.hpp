@@ -0,0 +1,290 @@
+#pragma once
+
+#include "Loop_native.hpp"
+#include <coroutine>
+#include <mutex>
+
+
+namespace coco {
+
+/**
+ * Base class of the synchronization primitives for coroutines on different loops. The state is protected by a mutex
+ * that is only held for a few instructions. The waiting coroutines are awaitables in their coroutine frames that are
+ * linked into an intrusive FIFO list, therefore nothing gets allocated. Waiting coroutines get resumed on their own
+ * loop using post(), i.e. the wakeup path of the loop.
+ * For coroutines on one loop use the cheaper primitives in <coco/Async.hpp>.
+ */
+class AsyncWaitList_native {
+public:
+    /**
+     * Awaitable of a coroutine that waits on a primitive
+     */
+    class Waiter : public Loop_native::Handler {
+    public:
+        Waiter(AsyncWaitList_native &list, Loop_native &loop) : list(list), loop(loop) {}
+
+        bool await_ready() {return false;}
+
+        bool await_suspend(std::coroutine_handle<> coroutine) {
+            this->coroutine = coroutine;
+            return this->list.wait(*this);
+        }
+
+        void await_resume() {}
+
+        // gets called on the loop of the waiting coroutine
+        void handle() override {
+            this->coroutine.resume();
+        }
+
+    protected:
+        friend class AsyncWaitList_native;
+
+        AsyncWaitList_native &list;
+        Loop_native &loop;
+        std::coroutine_handle<> coroutine;
+        Waiter *nextWaiter = nullptr;
+    };
+
+    virtual ~AsyncWaitList_native() {}
+
+protected:
+    /**
+     * Let a coroutine wait, called with the mutex unlocked
+     * @param waiter awaitable of the coroutine
+     * @return true if the coroutine waits, false if it can continue right away
+     */
+    virtual bool wait(Waiter &waiter) = 0;
+
+    // append a waiter, the mutex has to be locked
+    void add(Waiter &waiter) {
+        waiter.nextWaiter = nullptr;
+        if (this->last == nullptr)
+            this->first = &waiter;
+        else
+            this->last->nextWaiter = &waiter;
+        this->last = &waiter;
+    }
+
+    // remove the first waiter, the mutex has to be locked
+    Waiter *removeFirst() {
+        Waiter *waiter = this->first;
+        if (waiter != nullptr) {
+            this->first = waiter->nextWaiter;
+            if (this->first == nullptr)
+                this->last = nullptr;
+            waiter->nextWaiter = nullptr;
+        }
+        return waiter;
+    }
+
+    // remove all waiters, the mutex has to be locked
+    Waiter *removeAll() {
+        Waiter *waiter = this->first;
+        this->first = nullptr;
+        this->last = nullptr;
+        return waiter;
+    }
+
+    // resume waiters on their loops, called with the mutex unlocked
+    static void resume(Waiter *waiter) {
+        while (waiter != nullptr) {
+            // read next before posting as the waiter may get resumed and destroyed on another thread
+            Waiter *next = waiter->nextWaiter;
+            waiter->loop.post(*waiter);
+            waiter = next;
+        }
+    }
+
+    std::mutex mutex;
+    Waiter *first = nullptr;
+    Waiter *last = nullptr;
+};
+
+/**
+ * Event that coroutines on any loop can wait on until it is set. Thread safe.
+ */
+class AsyncEvent_native : public AsyncWaitList_native {
+public:
+    AsyncEvent_native(bool set = false) : flag(set) {}
+
+    /**
+     * Wait using co_await until the event is set, does not wait if the event is set already
+     * @param loop loop of the waiting coroutine
+     */
+    [[nodiscard]] Waiter wait(Loop_native &loop) {return {*this, loop};}
+
+    /**
+     * Set the event and resume all waiting coroutines on their loops
+     */
+    void set() {
+        Waiter *waiters;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->flag = true;
+            waiters = removeAll();
+        }
+        resume(waiters);
+    }
+
+    /**
+     * Reset the event so that coroutines wait again
+     */
+    void reset() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->flag = false;
+    }
+
+protected:
+    bool wait(Waiter &waiter) override {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->flag)
+            return false;
+        add(waiter);
+        return true;
+    }
+
+    bool flag;
+};
+
+/**
+ * Counting semaphore for coroutines on any loop, release() passes the permit directly to the first waiting
+ * coroutine. Thread safe.
+ */
+class AsyncSemaphore_native : public AsyncWaitList_native {
+public:
+    /**
+     * Constructor
+     * @param count initial number of permits
+     */
+    explicit AsyncSemaphore_native(int count) : count(count) {}
+
+    /**
+     * Try to acquire a permit without waiting
+     * @return true if successful
+     */
+    bool tryAcquire() {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->count <= 0)
+            return false;
+        --this->count;
+        return true;
+    }
+
+    /**
+     * Acquire a permit using co_await, waits in FIFO order until a permit is available
+     * @param loop loop of the waiting coroutine
+     */
+    [[nodiscard]] Waiter acquire(Loop_native &loop) {return {*this, loop};}
+
+    /**
+     * Release a permit, resumes the first waiting coroutine on its loop which then owns the permit
+     */
+    void release() {
+        Waiter *waiter;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            waiter = removeFirst();
+            if (waiter == nullptr) {
+                ++this->count;
+                return;
+            }
+        }
+        resume(waiter);
+    }
+
+protected:
+    bool wait(Waiter &waiter) override {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->count > 0) {
+            --this->count;
+            return false;
+        }
+        add(waiter);
+        return true;
+    }
+
+    int count;
+};
+
+/**
+ * Mutex for coroutines on any loop, unlock() passes the lock directly to the first waiting coroutine. Thread safe.
+ */
+class AsyncMutex_native : private AsyncSemaphore_native {
+public:
+    using AsyncSemaphore_native::Waiter;
+
+    AsyncMutex_native() : AsyncSemaphore_native(1) {}
+
+    /**
+     * Try to lock the mutex without waiting
+     * @return true if successful
+     */
+    bool tryLock() {return tryAcquire();}
+
+    /**
+     * Lock the mutex using co_await, waits in FIFO order until the mutex is unlocked
+     * @param loop loop of the waiting coroutine
+     */
+    [[nodiscard]] Waiter lock(Loop_native &loop) {return acquire(loop);}
+
+    /**
+     * Unlock the mutex, resumes the first waiting coroutine on its loop which then owns the lock. Unlocking a mutex
+     * that is not locked leaves it unlocked, i.e. the mutex never has more than one permit.
+     */
+    void unlock() {
+        Waiter *waiter;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            waiter = removeFirst();
+            if (waiter == nullptr) {
+                this->count = 1;
+                return;
+            }
+        }
+        resume(waiter);
+    }
+};
+
+/**
+ * Barrier for a fixed number of coroutines on any loop, the last coroutine that arrives resumes the others on their
+ * loops. The barrier can be used again for the next phase. Thread safe.
+ * An arrival can't be withdrawn, therefore arrive() can't be combined with a timeout.
+ */
+class AsyncBarrier_native : public AsyncWaitList_native {
+public:
+    /**
+     * Constructor
+     * @param count number of coroutines that have to arrive
+     */
+    explicit AsyncBarrier_native(int count) : count(count) {}
+
+    /**
+     * Arrive at the barrier and wait using co_await until all coroutines have arrived
+     * @param loop loop of the waiting coroutine
+     */
+    [[nodiscard]] Waiter arrive(Loop_native &loop) {return {*this, loop};}
+
+protected:
+    bool wait(Waiter &waiter) override {
+        Waiter *waiters;
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (++this->arrived < this->count) {
+                add(waiter);
+                return true;
+            }
+
+            // last coroutine: start the next phase
+            this->arrived = 0;
+            waiters = removeAll();
+        }
+        resume(waiters);
+        return false;
+    }
+
+    int count;
+    int arrived = 0;
+};
+
+} // namespace coco
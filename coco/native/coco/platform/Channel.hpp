@@ -0,0 +1,269 @@
+#pragma once
+
+#include "Loop_native.hpp"
+#include <coco/IntrusiveMpscQueue.hpp>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <utility>
+
+
+namespace coco {
+
+/**
+ * Bounded lock-free channel for passing values from coroutines on any loop to one receiving coroutine on the
+ * receiving loop. The values are stored in a ring buffer with a sequence number per slot, producers claim slots with
+ * a CAS on the tail, the consumer index and the producer index are on separate cache lines. A waiting receiver is
+ * woken using one post() per wait, i.e. at most one system call per batch of values. Senders that find the channel
+ * full wait in an intrusive queue and get resumed on their loop when a value was received, nothing gets allocated.
+ * Usage:
+ *
+ * Channel<int, 64> channel(receiverLoop);
+ *
+ * Coroutine producer(Loop &loop, Channel<int, 64> &channel) {
+ *     co_await channel.send(loop, 5);
+ * }
+ *
+ * Coroutine consumer(Channel<int, 64> &channel) {
+ *     while (true) {
+ *         int value = co_await channel.receive();
+ *     }
+ * }
+ *
+ * @tparam T value type, must be default constructible and movable
+ * @tparam N capacity, a power of two
+ */
+template <typename T, int N>
+class Channel {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of two and at least 2");
+public:
+    /**
+     * Constructor
+     * @param loop loop of the receiving coroutine
+     */
+    Channel(Loop_native &loop) : loop(loop) {
+        for (int i = 0; i < N; ++i)
+            this->slots[i].sequence.store(i, std::memory_order_relaxed);
+        this->receiveHandler.channel = this;
+    }
+
+    /**
+     * Try to send a value without waiting. Thread safe.
+     * @param value value to send
+     * @return true if successful, false if the channel is full
+     */
+    bool trySend(T &&value) {
+        if (!push(value))
+            return false;
+        wakeReceiver();
+        return true;
+    }
+
+    /**
+     * Awaitable for send()
+     */
+    class Send : public Loop_native::Handler {
+    public:
+        Send(Channel &channel, Loop_native &loop, T &&value) : channel(channel), loop(loop), value(std::move(value)) {}
+
+        bool await_ready() {
+            return this->channel.trySend(std::move(this->value));
+        }
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            this->coroutine = coroutine;
+            this->channel.wait(*this);
+        }
+
+        void await_resume() {}
+
+        // gets called on the loop of the sender when the receiver has made room, the sender retries then
+        void handle() override {
+            if (this->channel.trySend(std::move(this->value)))
+                this->coroutine.resume();
+            else
+                this->channel.wait(*this);
+        }
+
+    protected:
+        friend class Channel;
+
+        Channel &channel;
+        Loop_native &loop;
+        T value;
+        std::coroutine_handle<> coroutine;
+    };
+
+    /**
+     * Send a value using co_await, waits while the channel is full. Thread safe.
+     * @param loop loop of the sending coroutine on which it gets resumed
+     * @param value value to send
+     */
+    [[nodiscard]] Send send(Loop_native &loop, T value) {return {*this, loop, std::move(value)};}
+
+    /**
+     * Try to receive a value without waiting, only called on the receiving loop
+     * @param value received value
+     * @return true if successful, false if the channel is empty
+     */
+    bool tryReceive(T &value) {
+        if (!pop(value))
+            return false;
+        wakeSender();
+        return true;
+    }
+
+    /**
+     * Awaitable for receive()
+     */
+    class Receive {
+    public:
+        Receive(Channel &channel) : channel(channel) {}
+
+        bool await_ready() {
+            return !this->channel.empty();
+        }
+
+        bool await_suspend(std::coroutine_handle<> coroutine) {
+            this->channel.receiver = coroutine;
+            return this->channel.prepareWait();
+        }
+
+        T await_resume() {
+            // the channel is not empty as there is only one receiver
+            T value{};
+            this->channel.tryReceive(value);
+            return value;
+        }
+
+    protected:
+        Channel &channel;
+    };
+
+    /**
+     * Receive a value using co_await, waits while the channel is empty. Only one coroutine on the receiving loop may
+     * receive.
+     */
+    [[nodiscard]] Receive receive() {return {*this};}
+
+    /**
+     * Check if the channel is empty, only called on the receiving loop
+     */
+    bool empty() {
+        auto &slot = this->slots[this->head & MASK];
+        return slot.sequence.load(std::memory_order_acquire) != this->head + 1;
+    }
+
+protected:
+    static constexpr std::size_t MASK = N - 1;
+
+    // claim a slot at the tail and store the value
+    bool push(T &value) {
+        std::size_t tail = this->tail.load(std::memory_order_relaxed);
+        while (true) {
+            auto &slot = this->slots[tail & MASK];
+            std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t difference = std::ptrdiff_t(sequence) - std::ptrdiff_t(tail);
+            if (difference == 0) {
+                // slot is free: try to claim it
+                if (this->tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(value);
+                    slot.sequence.store(tail + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                // full
+                return false;
+            } else {
+                // another producer was faster
+                tail = this->tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // take the value at the head
+    bool pop(T &value) {
+        auto &slot = this->slots[this->head & MASK];
+        if (slot.sequence.load(std::memory_order_acquire) != this->head + 1)
+            return false;
+        value = std::move(slot.value);
+        slot.sequence.store(this->head + N, std::memory_order_release);
+        ++this->head;
+        return true;
+    }
+
+    // resume the receiver on its loop if it is waiting, only the first value after the receiver started waiting
+    // posts the receive handler. The fence orders the store of the value before the load of receiverWaiting,
+    // prepareWait() does the same in reverse
+    void wakeReceiver() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (this->receiverWaiting.load(std::memory_order_relaxed) && this->receiverWaiting.exchange(false))
+            this->loop.post(this->receiveHandler);
+    }
+
+    // let a waiting sender retry on its loop
+    void wakeSender() {
+        Send *sender = this->senders.pop();
+        if (sender != nullptr)
+            sender->loop.post(*sender);
+    }
+
+    // let a sender wait until the receiver has made room. The receiver gets woken up in case it is waiting as
+    // it may have missed the sender when it has emptied the channel
+    void wait(Send &sender) {
+        this->senders.push(sender);
+        wakeReceiver();
+    }
+
+    // announce that the receiver waits, returns false if it can continue right away
+    bool prepareWait() {
+        // let waiting senders retry as the channel is empty
+        while (Send *sender = this->senders.pop())
+            sender->loop.post(*sender);
+
+        this->receiverWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!empty()) {
+            // a value arrived in the meantime: continue unless a sender has already posted the receive handler
+            return !this->receiverWaiting.exchange(false);
+        }
+        return true;
+    }
+
+    // gets called on the receiving loop when a value was sent or a sender waits
+    class ReceiveHandler : public Loop_native::Handler {
+    public:
+        void handle() override {
+            if (this->channel->prepareWait())
+                return;
+            this->channel->receiver.resume();
+        }
+
+        Channel *channel;
+    };
+
+    Loop_native &loop;
+
+    // slot of the ring buffer, the sequence tells if the slot is free for the producer or full for the consumer
+    struct Slot {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+    Slot slots[N];
+
+    // consumer index, only used by the receiving loop
+    alignas(64) std::size_t head = 0;
+    std::coroutine_handle<> receiver;
+    ReceiveHandler receiveHandler;
+
+    // producer index
+    alignas(64) std::atomic<std::size_t> tail = 0;
+
+    // set while the receiver waits
+    alignas(64) std::atomic<bool> receiverWaiting = false;
+
+    // senders that wait until the receiver has made room
+    IntrusiveMpscQueue<Send> senders;
+};
+
+} // namespace coco
@@ -0,0 +1,180 @@
+#include "LoopPool.hpp"
+#include <algorithm>
+#include <iostream>
+#ifdef _WIN32
+#include "Windows.h"
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+namespace coco {
+
+thread_local LoopPool::Worker *LoopPool::current = nullptr;
+
+LoopPool::LoopPool() : LoopPool(int(std::thread::hardware_concurrency())) {
+}
+
+LoopPool::LoopPool(int count, bool workStealing) : workStealing(workStealing) {
+	int cpuCount = std::max(int(std::thread::hardware_concurrency()), 1);
+	if (count < 1)
+		count = 1;
+	std::vector<int> cpus;
+	for (int i = 0; i < count; ++i)
+		cpus.push_back(i % cpuCount);
+	start(cpus);
+}
+
+LoopPool::LoopPool(const std::vector<int> &cpus, bool workStealing) : workStealing(workStealing) {
+	start(cpus);
+}
+
+LoopPool::~LoopPool() {
+	exit();
+	join();
+}
+
+void LoopPool::exit() {
+	// only the first call posts to the loops, a loop that has exited would never call the posted handler
+	if (this->exited.exchange(true))
+		return;
+
+	// exit the loops on their own threads as exit() of a loop is not thread safe
+	for (auto &worker : this->workers) {
+		auto loop = worker->loop.get();
+		loop->post([loop] {loop->exit();});
+	}
+}
+
+void LoopPool::join() {
+	for (auto &worker : this->workers) {
+		if (worker->thread.joinable())
+			worker->thread.join();
+	}
+}
+
+void LoopPool::start(const std::vector<int> &cpus) {
+	// create all loops on the calling thread before the threads start so that the loops can be used as soon as the
+	// constructor returns and can steal from each other
+	int count = int(cpus.size());
+	for (int i = 0; i < count; ++i) {
+		auto worker = std::make_unique<Worker>();
+		worker->pool = this;
+		worker->index = i;
+		worker->loop = std::make_unique<Loop_native>();
+		worker->loop->idleHandler = worker.get();
+		this->workers.push_back(std::move(worker));
+	}
+
+	for (int i = 0; i < count; ++i) {
+		auto worker = this->workers[i].get();
+		int cpu = cpus[i];
+		worker->thread = std::thread([worker, cpu] {
+			pin(cpu);
+			LoopPool::current = worker;
+			worker->loop->run();
+		});
+	}
+}
+
+void LoopPool::pin(int cpu) {
+#ifdef _WIN32
+	if (cpu < 64 && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu) == 0) {
+		auto e = GetLastError();
+		std::cout << "SetThreadAffinityMask: " << e << std::endl;
+	}
+#else
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	int e = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+	if (e != 0)
+		std::cout << "pthread_setaffinity_np: " << e << std::endl;
+#endif
+}
+
+
+// LoopPool::Schedule
+
+bool LoopPool::Schedule::await_suspend(std::coroutine_handle<> coroutine) {
+	// this awaitable lives in the coroutine frame which a thief may resume and destroy as soon as the coroutine is in
+	// the deque, therefore it must not be used after the push
+	auto &pool = this->pool;
+	auto worker = LoopPool::current;
+	if (worker == nullptr || worker->pool != &pool) {
+		// not called from a loop of the pool: move to the next loop
+		this->coroutine = coroutine;
+		pool.next().post(*this);
+		return true;
+	}
+
+	// continue right away if the deque is full
+	if (!worker->deque.push(coroutine.address()))
+		return false;
+
+	// the loop resumes the coroutine in its next iteration, wake up an idle loop if there is more work than that
+	if (pool.workStealing && worker->deque.size() > 1) {
+		int count = pool.size();
+		for (int i = 1; i < count; ++i) {
+			if (pool.workers[(worker->index + i) % count]->loop->wakeup())
+				break;
+		}
+	}
+	return true;
+}
+
+void LoopPool::Schedule::handle() {
+	this->coroutine.resume();
+}
+
+
+// LoopPool::SwitchTo
+
+void LoopPool::SwitchTo::await_suspend(std::coroutine_handle<> coroutine) {
+	this->coroutine = coroutine;
+	this->pool.on(this->index).post(*this);
+}
+
+void LoopPool::SwitchTo::handle() {
+	this->pool.workers[this->index]->migrationCount.fetch_add(1, std::memory_order_relaxed);
+	this->coroutine.resume();
+}
+
+
+// LoopPool::Worker
+
+bool LoopPool::Worker::handle() {
+	// resume the coroutines that were scheduled until now in FIFO order by taking them from the top like a thief,
+	// coroutines that schedule again are pushed at the bottom and get resumed after the others
+	bool result = false;
+	int count = this->deque.size();
+	void *address;
+	while (count > 0) {
+		if (!this->deque.steal(address)) {
+			// either empty because thieves were faster or lost a race against a thief
+			if (this->deque.size() == 0)
+				break;
+			continue;
+		}
+		std::coroutine_handle<>::from_address(address).resume();
+		--count;
+		result = true;
+	}
+	if (result || !this->pool->workStealing)
+		return result;
+
+	// nothing to do: steal a coroutine from another loop
+	int loopCount = this->pool->size();
+	for (int i = 1; i < loopCount; ++i) {
+		auto &victim = *this->pool->workers[(this->index + i) % loopCount];
+		if (victim.deque.steal(address)) {
+			this->stealCount.fetch_add(1, std::memory_order_relaxed);
+			std::coroutine_handle<>::from_address(address).resume();
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace coco
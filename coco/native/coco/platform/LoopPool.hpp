@@ -0,0 +1,228 @@
+#pragma once
+
+#include "Loop_native.hpp"
+#include <coco/WorkStealingDeque.hpp>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace coco {
+
+/**
+ * Pool of native event loops, each running on its own thread that is pinned to a cpu. The loops share nothing, each
+ * has its own timer store and handler queue, work is passed to a loop using post(). Usage:
+ *
+ * LoopPool pool;
+ * pool.on(0).post([] {...});
+ * pool.next().post([] {...});
+ * pool.forKey(connectionId).post([] {...});
+ *
+ * Optionally the loops steal work from each other: A coroutine that is movable between loops calls
+ * co_await pool.schedule() to put itself into the work-stealing deque of its loop. Loops that have nothing to do
+ * steal coroutines from the other loops before they block. A coroutine that was scheduled may continue on another
+ * thread, it has to use pool.currentLoop() instead of a loop it has captured before. Coroutines that hold
+ * loop-affine resources (file descriptors, timers, GUI) are pinned by not calling schedule() or return to their
+ * loop using co_await pool.switchTo(index).
+ */
+class LoopPool {
+public:
+    /**
+     * Constructor, starts one loop per hardware thread, loop i is pinned to cpu i
+     */
+    LoopPool();
+
+    /**
+     * Constructor, starts the given number of loops, loop i is pinned to cpu i modulo the number of hardware threads
+     * @param count number of loops
+     * @param workStealing true to let idle loops steal scheduled coroutines from other loops
+     */
+    explicit LoopPool(int count, bool workStealing = false);
+
+    /**
+     * Constructor, starts one loop for each given cpu
+     * @param cpus cpus to pin the loops to, at least one
+     * @param workStealing true to let idle loops steal scheduled coroutines from other loops
+     */
+    explicit LoopPool(const std::vector<int> &cpus, bool workStealing = false);
+
+    /**
+     * Destructor, exits the loops and waits until their threads have finished. Must not be called from one of the
+     * loops.
+     */
+    ~LoopPool();
+
+    /**
+     * Get the number of loops
+     */
+    int size() {return int(this->workers.size());}
+
+    /**
+     * Get a loop by index. Only use the thread safe methods such as post() from other threads.
+     * @param index index of the loop
+     * @return loop
+     */
+    Loop_native &on(int index) {return *this->workers[index]->loop;}
+
+    /**
+     * Get the next loop in round-robin order
+     * @return loop
+     */
+    Loop_native &next() {
+        unsigned index = this->nextIndex.fetch_add(1, std::memory_order_relaxed);
+        return on(int(index % unsigned(this->workers.size())));
+    }
+
+    /**
+     * Get the loop for a key, e.g. a connection id, so that all work for the same key runs on the same loop
+     * @param key key
+     * @return loop
+     */
+    Loop_native &forKey(std::size_t key) {return on(int(key % this->workers.size()));}
+
+    /**
+     * Get the index of the loop that runs on the calling thread
+     * @return index of the loop or -1 if the calling thread does not belong to this pool
+     */
+    int currentIndex() {
+        auto worker = LoopPool::current;
+        return worker != nullptr && worker->pool == this ? worker->index : -1;
+    }
+
+    /**
+     * Get the loop that runs on the calling thread, must be called from a thread of this pool
+     * @return loop
+     */
+    Loop_native &currentLoop() {return *LoopPool::current->loop;}
+
+    /**
+     * Post a function to the next loop in round-robin order. Thread safe.
+     * @param function function to call on the thread of the loop
+     */
+    template <typename F>
+    void post(F &&function) {
+        next().post(std::forward<F>(function));
+    }
+
+    /**
+     * Awaitable for schedule()
+     */
+    class Schedule : public Loop_native::Handler {
+    public:
+        Schedule(LoopPool &pool) : pool(pool) {}
+
+        bool await_ready() {return false;}
+        bool await_suspend(std::coroutine_handle<> coroutine);
+        void await_resume() {}
+
+        void handle() override;
+
+    protected:
+        LoopPool &pool;
+        std::coroutine_handle<> coroutine;
+    };
+
+    /**
+     * Suspend execution using co_await and put the coroutine into the work-stealing deque of the current loop. The
+     * coroutine gets resumed in the next iteration of the current loop or by an idle loop that steals it. A loop
+     * resumes its scheduled coroutines in FIFO order, therefore a coroutine that keeps scheduling itself does not
+     * starve the others. If called from a thread that does not belong to the pool, the coroutine moves to the next loop
+     * in round-robin order.
+     */
+    [[nodiscard]] Schedule schedule() {return {*this};}
+
+    /**
+     * Awaitable for switchTo()
+     */
+    class SwitchTo : public Loop_native::Handler {
+    public:
+        SwitchTo(LoopPool &pool, int index) : pool(pool), index(index) {}
+
+        bool await_ready() {return this->pool.currentIndex() == this->index;}
+        void await_suspend(std::coroutine_handle<> coroutine);
+        void await_resume() {}
+
+        void handle() override;
+
+    protected:
+        LoopPool &pool;
+        int index;
+        std::coroutine_handle<> coroutine;
+    };
+
+    /**
+     * Suspend execution using co_await and resume on the given loop, e.g. to return to the loop that owns a
+     * loop-affine resource. Does not suspend if the coroutine runs on the given loop already.
+     * @param index index of the loop
+     */
+    [[nodiscard]] SwitchTo switchTo(int index) {return {*this, index};}
+
+    /**
+     * Get the number of coroutines a loop has stolen from other loops
+     * @param index index of the loop
+     */
+    int stealCount(int index) {return this->workers[index]->stealCount.load(std::memory_order_relaxed);}
+
+    /**
+     * Get the number of coroutines that were moved to a loop using switchTo()
+     * @param index index of the loop
+     */
+    int migrationCount(int index) {return this->workers[index]->migrationCount.load(std::memory_order_relaxed);}
+
+    /**
+     * Exit all loops without waiting for their threads. Posted handlers and events that are already in flight are
+     * handled before a loop exits. Thread safe, can also be called from one of the loops, e.g. by a handler that
+     * shuts down the server.
+     */
+    void exit();
+
+    /**
+     * Wait until the threads of all loops have finished, i.e. until exit() was called and the loops have exited.
+     * Must not be called from one of the loops.
+     */
+    void join();
+
+protected:
+    void start(const std::vector<int> &cpus);
+
+    // pin the calling thread to a cpu
+    static void pin(int cpu);
+
+    // loop with its thread and work-stealing deque
+    class Worker : public Loop_native::IdleHandler {
+    public:
+        // resume scheduled coroutines, steal from other loops if there are none
+        bool handle() override;
+
+        LoopPool *pool;
+        int index;
+        std::unique_ptr<Loop_native> loop;
+        std::thread thread;
+
+        // coroutines that were scheduled on this loop
+        WorkStealingDeque<void *> deque;
+
+        // number of coroutines this loop has stolen from other loops
+        std::atomic<int> stealCount = 0;
+
+        // number of coroutines that were moved to this loop using switchTo()
+        std::atomic<int> migrationCount = 0;
+    };
+    std::vector<std::unique_ptr<Worker>> workers;
+    bool workStealing;
+
+    // set by the first call to exit()
+    std::atomic<bool> exited = false;
+
+    // index for round-robin dispatch
+    std::atomic<unsigned> nextIndex = 0;
+
+    // worker of the calling thread
+    static thread_local Worker *current;
+};
+
+} // namespace coco
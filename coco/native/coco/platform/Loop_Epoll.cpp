@@ -0,0 +1,502 @@
+#include "Loop_Epoll.hpp"
+#include <algorithm>
+#include <iterator>
+#include <iostream>
+#include <cerrno>
+#include <ctime>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+
+namespace coco {
+
+// maximum sleep time is 12 days
+constexpr int MAX_SLEEP = 0x3fffffff;
+
+// resume the tasks that are waiting now, tasks that wait again while being resumed stay in the list
+template <typename L>
+void resumeWaiting(L &list) {
+	int count = 0;
+	for (auto it = list.begin(); it != list.end(); ++it)
+		++count;
+	while (count > 0) {
+		list.doFirst();
+		--count;
+	}
+}
+
+
+Loop_Epoll::Loop_Epoll() {
+	// create epoll instance
+	this->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (this->epollFd == -1) {
+		auto e = errno;
+		std::cout << "epoll_create1: " << e << std::endl;
+	}
+
+	// create timer for waking up when the first sleep task is due
+	this->timerHandler.loop = this;
+	this->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (this->timerFd == -1) {
+		auto e = errno;
+		std::cout << "timerfd_create: " << e << std::endl;
+	}
+	add(this->timerFd, this->timerHandler);
+	refreshNow();
+
+	// create eventfd for waking up the loop from other threads
+	this->eventHandler.loop = this;
+	this->eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (this->eventFd == -1) {
+		auto e = errno;
+		std::cout << "eventfd: " << e << std::endl;
+	}
+	add(this->eventFd, this->eventHandler);
+
+	// signalfd gets created when the first signal is added
+	this->signalHandler.loop = this;
+	sigemptyset(&this->signalMask);
+}
+
+Loop_Epoll::~Loop_Epoll() {
+	if (this->signalFd != -1) {
+		close(this->signalFd);
+
+		// unblock signals so that they get their default disposition again
+		pthread_sigmask(SIG_UNBLOCK, &this->signalMask, nullptr);
+	}
+	close(this->eventFd);
+	close(this->timerFd);
+	close(this->epollFd);
+}
+
+void Loop_Epoll::run() {
+	while (!this->exitFlag) {
+		handleEvents();
+	}
+
+	// drain work that is already in flight, e.g. posted handlers and file descriptors that are ready
+	handleEvents(0);
+	this->exitFlag = false;
+}
+
+Loop::Time Loop_Epoll::now() {
+	// CLOCK_MONOTONIC is read via vDSO without a system call
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return Time(int(time.tv_sec * 1000 + time.tv_nsec / 1000000));
+}
+
+Microseconds<int64_t> Loop_Epoll::nowMicroseconds() {
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return {time.tv_sec * 1000000 + time.tv_nsec / 1000};
+}
+
+Microseconds<> Loop_Epoll::resolution() {
+	timespec resolution;
+	clock_getres(CLOCK_MONOTONIC, &resolution);
+	int us = int(resolution.tv_sec * 1000000 + resolution.tv_nsec / 1000);
+	return {us > 1 ? us : 1};
+}
+
+Awaitable<CoroutineTimedTask> Loop_Epoll::sleep(Time time) {
+	return {this->sleepTasks2.list(time), time};
+}
+
+Awaitable<> Loop_Epoll::signal(int signo) {
+	addSignal(signo);
+	return {this->signalTasks2[signo]};
+}
+
+void Loop_Epoll::invoke(Task<Callback> &task, int signo) {
+	addSignal(signo);
+	task.cancel();
+	this->signalTasks1[signo].add(task);
+}
+
+bool Loop_Epoll::add(int fd, ReadyHandler &handler, uint32_t events) {
+	epoll_event event;
+	event.events = events;
+	event.data.ptr = &handler;
+	if (epoll_ctl(this->epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+		auto e = errno;
+		std::cout << "epoll_ctl: " << e << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Loop_Epoll::modify(int fd, ReadyHandler &handler, uint32_t events) {
+	epoll_event event;
+	event.events = events;
+	event.data.ptr = &handler;
+	if (epoll_ctl(this->epollFd, EPOLL_CTL_MOD, fd, &event) == -1) {
+		auto e = errno;
+		std::cout << "epoll_ctl: " << e << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void Loop_Epoll::remove(int fd) {
+	epoll_ctl(this->epollFd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void Loop_Epoll::post(Handler &handler) {
+	this->postQueue.push(handler);
+	wakeup();
+}
+
+bool Loop_Epoll::wakeup() {
+	// wake up the loop if it is waiting, only the first wakeup after the loop went to sleep needs the system call
+	if (this->sleeping.exchange(false)) {
+		uint64_t value = 1;
+		if (write(this->eventFd, &value, sizeof(value)) == -1) {
+			// EAGAIN if the counter is about to overflow, then the loop gets woken up anyway
+			auto e = errno;
+			if (e != EAGAIN)
+				std::cout << "write: " << e << std::endl;
+		}
+		return true;
+	}
+	return false;
+}
+
+bool Loop_Epoll::handleEvents(int wait) {
+	// don't block if tasks or coroutines wait on invoke() or yield()
+	if (hasYieldTasks())
+		wait = 0;
+
+	// spin for new events before blocking
+	bool result = spin(wait);
+	if (result)
+		wait = 0;
+
+	// call the idle handler and don't block if it has done work
+	if (this->idleHandler != nullptr && this->idleHandler->handle())
+		wait = 0;
+
+	// announce that the loop may block, then call posted handlers and don't block if there were any
+	this->sleeping = true;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (handlePosted())
+		wait = 0;
+
+	// arm the timer to the first sleep task and wait for file descriptors to become ready
+	armTimer();
+	if (wait > 0)
+		++this->blockCount;
+	result |= handleReady(wait);
+	this->sleeping.store(false, std::memory_order_relaxed);
+
+	// call handlers that were posted while waiting
+	handlePosted();
+
+	// resume coroutines waiting on yield() and activate yield handlers
+	handleYield();
+
+	// resume coroutines waiting on sleep() and activate time handlers
+	{
+		Time currentTime = refreshNow();
+		int count = this->sleepTasks1.doUntil(currentTime);
+		count += this->sleepTasks2.doUntil(currentTime);
+		countCoalesced(count);
+	}
+
+	return result;
+}
+
+bool Loop_Epoll::spin(int wait) {
+	if (wait <= 0 || this->spinTime.value <= 0)
+		return false;
+
+	// spin at most for the given wait time
+	int64_t spinTime = std::min(int64_t(this->spinTime.value) * 1000, int64_t(wait) * 1000000);
+	Time sleepTime = this->sleepTasks2.getFirstTime(this->sleepTasks1.getFirstTime(this->cachedTime + MAX_SLEEP * 1ms));
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	int64_t start = time.tv_sec * 1000000000 + time.tv_nsec;
+	int64_t ns = start;
+	do {
+		// check for posted handlers, ready events and due sleep tasks
+		if (handlePosted() || poll() || sleepTime <= Time(int(ns / 1000000))) {
+			++this->spinHitCount;
+			return true;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &time);
+		ns = time.tv_sec * 1000000000 + time.tv_nsec;
+	} while (ns - start < spinTime);
+	return false;
+}
+
+bool Loop_Epoll::poll() {
+	return handleReady(0);
+}
+
+void Loop_Epoll::armTimer() {
+	if (this->sleepTasks1.empty() && this->sleepTasks2.empty())
+		return;
+
+	// only set the timer if the first sleep task has changed
+	Time sleepTime = this->sleepTasks2.getFirstTime(this->sleepTasks1.getFirstTime(this->cachedTime + MAX_SLEEP * 1ms));
+	if (this->timerArmed && sleepTime == this->timerTime)
+		return;
+	this->timerTime = sleepTime;
+	this->timerArmed = true;
+
+	// convert to absolute time of CLOCK_MONOTONIC, a time in the past lets the timer expire immediately
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	int64_t ms = time.tv_sec * 1000 + time.tv_nsec / 1000000;
+	ms += (sleepTime - Time(int(ms))).value;
+	itimerspec value = {};
+	value.it_value.tv_sec = ms / 1000;
+	value.it_value.tv_nsec = (ms % 1000) * 1000000;
+	if (timerfd_settime(this->timerFd, TFD_TIMER_ABSTIME, &value, nullptr) == -1) {
+		auto e = errno;
+		std::cout << "timerfd_settime: " << e << std::endl;
+
+		// try again in the next iteration
+		this->timerArmed = false;
+	}
+}
+
+void Loop_Epoll::addSignal(int signo) {
+	if (sigismember(&this->signalMask, signo) == 1)
+		return;
+	sigaddset(&this->signalMask, signo);
+
+	// block the signal so that it is only delivered through the signalfd
+	sigset_t mask;
+	sigemptyset(&mask);
+	sigaddset(&mask, signo);
+	pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+
+	// create the signalfd or update its mask
+	int fd = signalfd(this->signalFd, &this->signalMask, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (fd == -1) {
+		auto e = errno;
+		std::cout << "signalfd: " << e << std::endl;
+		return;
+	}
+	if (this->signalFd == -1) {
+		this->signalFd = fd;
+		add(fd, this->signalHandler);
+	}
+}
+
+bool Loop_Epoll::handlePosted() {
+	bool result = false;
+	Handler *handler;
+	while ((handler = this->postQueue.pop()) != nullptr) {
+		handler->handle();
+		result = true;
+	}
+	return result;
+}
+
+bool Loop_Epoll::handleReady(int timeout) {
+	// wait for file descriptors to become ready
+	epoll_event events[16];
+	int eventCount = epoll_wait(this->epollFd, events, std::size(events), timeout);
+
+	// the loop may have been waiting, read the clock before the handlers get called
+	if (timeout != 0)
+		refreshNow();
+
+	if (eventCount > 0) {
+		// one or more file descriptors are ready: call handler
+		for (int i = 0; i < eventCount; ++i) {
+			auto &event = events[i];
+			auto handler = (ReadyHandler *)(event.data.ptr);
+			handler->handle(event.events);
+		}
+		return true;
+	}
+	if (eventCount == -1) {
+		// error (EINTR when interrupted by a signal)
+		auto e = errno;
+		if (e != EINTR)
+			std::cout << "epoll_wait: " << e << std::endl;
+	}
+	return false;
+}
+
+
+// Loop_Epoll::ReadyHandler
+
+Loop_Epoll::ReadyHandler::~ReadyHandler() {
+}
+
+
+// Loop_Epoll::TimerHandler
+
+void Loop_Epoll::TimerHandler::handle(uint32_t events) {
+	// clear expiration count, the timer is disarmed now
+	uint64_t count;
+	if (read(this->loop->timerFd, &count, sizeof(count)) == -1) {
+		// EAGAIN if the timer was re-armed after it has expired
+		auto e = errno;
+		if (e != EAGAIN)
+			std::cout << "read: " << e << std::endl;
+		return;
+	}
+	this->loop->timerArmed = false;
+}
+
+
+// Loop_Epoll::SignalHandler
+
+void Loop_Epoll::SignalHandler::handle(uint32_t events) {
+	auto loop = this->loop;
+
+	// read all pending signals and resume the tasks waiting on them
+	signalfd_siginfo info;
+	int size;
+	while ((size = read(loop->signalFd, &info, sizeof(info))) == sizeof(info)) {
+		int signo = info.ssi_signo;
+		if (signo > 0 && signo < NSIG) {
+			resumeWaiting(loop->signalTasks1[signo]);
+			resumeWaiting(loop->signalTasks2[signo]);
+		}
+	}
+
+	// EAGAIN when all pending signals have been read
+	if (size == -1) {
+		auto e = errno;
+		if (e != EAGAIN)
+			std::cout << "read: " << e << std::endl;
+	}
+}
+
+
+// Loop_Epoll::FileWatcher
+
+Loop_Epoll::FileWatcher::FileWatcher(Loop_Epoll &loop, Duration window)
+	: loop(loop), window(window), timer(makeCallback<&FileWatcher::deliver>(this))
+{
+	this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (this->fd == -1) {
+		auto e = errno;
+		std::cout << "inotify_init1: " << e << std::endl;
+		return;
+	}
+	loop.add(this->fd, *this);
+}
+
+Loop_Epoll::FileWatcher::~FileWatcher() {
+	this->timer.cancel();
+	if (this->fd != -1) {
+		this->loop.remove(this->fd);
+		close(this->fd);
+	}
+}
+
+int Loop_Epoll::FileWatcher::watch(const char *path, uint32_t mask) {
+	int wd = inotify_add_watch(this->fd, path, mask);
+	if (wd == -1) {
+		auto e = errno;
+		std::cout << "inotify_add_watch: " << e << std::endl;
+	}
+	return wd;
+}
+
+void Loop_Epoll::FileWatcher::unwatch(int wd) {
+	inotify_rm_watch(this->fd, wd);
+}
+
+Awaitable<> Loop_Epoll::FileWatcher::changed() {
+	// check if the coalescing window of the first change has elapsed while no coroutine was waiting
+	if (!this->changes.empty() && this->changes.front().time <= this->loop.now()) {
+		auto &change = this->changes.front();
+		this->wd = change.wd;
+		this->name = std::move(change.name);
+		this->events = change.events;
+		this->changes.erase(this->changes.begin());
+		return {};
+	}
+	return {this->tasks};
+}
+
+void Loop_Epoll::FileWatcher::handle(uint32_t events) {
+	// read all inotify events, the buffer is aligned for struct inotify_event
+	alignas(inotify_event) char buffer[4096];
+	int size;
+	while ((size = read(this->fd, buffer, sizeof(buffer))) > 0) {
+		for (int i = 0; i < size;) {
+			auto event = (inotify_event *)(buffer + i);
+			i += sizeof(inotify_event) + event->len;
+
+			// the watch was removed by unwatch() or because the watched path was deleted
+			if (event->mask & IN_IGNORED)
+				continue;
+
+			// coalesce with a pending change of the same path, the name is padded with null characters
+			const char *name = event->len > 0 ? event->name : "";
+			bool found = false;
+			for (auto &change : this->changes) {
+				if (change.wd == event->wd && change.name == name) {
+					change.events |= event->mask;
+					found = true;
+					break;
+				}
+			}
+			if (!found) {
+				// new change, its window ends after the windows of all other changes
+				Time time = this->loop.now() + this->window;
+				this->changes.push_back({event->wd, name, event->mask, time});
+				if (!this->timer.inList())
+					this->loop.invoke(this->timer, time);
+			}
+		}
+	}
+
+	// EAGAIN when all events have been read
+	if (size == -1) {
+		auto e = errno;
+		if (e != EAGAIN)
+			std::cout << "read: " << e << std::endl;
+	}
+}
+
+void Loop_Epoll::FileWatcher::deliver() {
+	// report changes whose window has elapsed to waiting coroutines
+	Time now = this->loop.now();
+	while (!this->changes.empty() && !this->tasks.empty()) {
+		auto &change = this->changes.front();
+		if (change.time > now)
+			break;
+		this->wd = change.wd;
+		this->name = std::move(change.name);
+		this->events = change.events;
+		this->changes.erase(this->changes.begin());
+		this->tasks.doFirst();
+	}
+
+	// wait for the window of the next pending change
+	for (auto &change : this->changes) {
+		if (change.time > now) {
+			this->loop.invoke(this->timer, change.time);
+			break;
+		}
+	}
+}
+
+
+// Loop_Epoll::EventHandler
+
+void Loop_Epoll::EventHandler::handle(uint32_t events) {
+	// clear eventfd counter, the posted handlers get called by handleEvents()
+	uint64_t value;
+	if (read(this->loop->eventFd, &value, sizeof(value)) == -1) {
+		// EAGAIN if another iteration has cleared the counter already
+		auto e = errno;
+		if (e != EAGAIN)
+			std::cout << "read: " << e << std::endl;
+	}
+}
+
+} // namespace coco
@@ -0,0 +1,369 @@
+#pragma once
+
+#include <coco/Loop.hpp>
+#include <coco/Callback.hpp>
+#include <coco/TimerStore.hpp>
+#include <coco/IntrusiveMpscQueue.hpp>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <csignal>
+#include <atomic>
+#include <concepts>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace coco {
+
+class ThreadPool;
+
+/**
+ * Implementation of the Loop interface using epoll on Linux.
+ * A single timerfd is armed with absolute time to the first sleep task and only re-armed when the first sleep task
+ * changes, therefore sleep tasks get the precision of the kernel's high resolution timers.
+ * Optionally the loop spins for spinTime before it blocks to reduce the wakeup latency at the cost of cpu time.
+ * Signals are received through a signalfd as ordinary loop events, e.g. for a clean shutdown:
+ *
+ * Coroutine shutdown(Loop_Epoll &loop) {
+ *     co_await loop.signal(SIGTERM);
+ *     loop.exit();
+ * }
+ */
+class Loop_Epoll : public Loop {
+public:
+
+    Loop_Epoll();
+    ~Loop_Epoll() override;
+
+    void run() override;
+    [[nodiscard]] Time now() override;
+    [[nodiscard]] Microseconds<int64_t> nowMicroseconds() override;
+    [[nodiscard]] Microseconds<> resolution() override;
+    [[nodiscard]] Awaitable<CoroutineTimedTask> sleep(Time time) override;
+    using Loop::sleep;
+    using Loop::invoke;
+
+
+    void invoke(TimedTask<Callback> &task, Time time) {
+        task.cancelAndSet(time);
+        this->sleepTasks1.add(task);
+    }
+
+    void invoke(TimedTask<Callback> &task, Duration duration) {
+        task.cancelAndSet(now() + duration);
+        this->sleepTasks1.add(task);
+    }
+
+    void invoke(TimedTask<Callback> &task) {
+        task.cancelAndSet(now());
+        this->sleepTasks1.add(task);
+    }
+
+    /**
+     * Call a task at a given time with a slack. The loop may call the task up to slack later so that timers whose
+     * windows overlap get handled in one wakeup.
+     */
+    void invoke(TimedTask<Callback> &task, Time time, Duration slack) {
+        task.cancelAndSet(coalesce(time, slack));
+        this->sleepTasks1.add(task);
+    }
+
+    void invoke(TimedTask<Callback> &task, Duration duration, Duration slack) {
+        task.cancelAndSet(coalesce(now() + duration, slack));
+        this->sleepTasks1.add(task);
+    }
+
+    /**
+     * Suspend execution using co_await until a signal arrives. The signal gets blocked for normal delivery, therefore
+     * call before other threads are started so that they inherit the signal mask.
+     * @param signo signal number, e.g. SIGTERM
+     */
+    [[nodiscard]] Awaitable<> signal(int signo);
+
+    /**
+     * Call a task when a signal arrives. The signal gets blocked for normal delivery, therefore call before other
+     * threads are started so that they inherit the signal mask.
+     * @param task task to call, gets called once
+     * @param signo signal number, e.g. SIGTERM
+     */
+    void invoke(Task<Callback> &task, int signo);
+
+
+    /**
+     * Handler that can be posted to the loop from other threads
+     */
+    class Handler : public IntrusiveMpscQueueNode {
+    public:
+        virtual ~Handler() {}
+        virtual void handle() = 0;
+    };
+
+    /**
+     * Post a handler to the loop. Thread safe, the handler gets called on the thread that runs the loop. Wakes up
+     * the loop if it is waiting for events, the wakeup is skipped if the loop is awake anyway.
+     * @param handler handler
+     */
+    void post(Handler &handler);
+
+    /**
+     * Post a function to the loop. Thread safe, the function gets called on the thread that runs the loop.
+     * @param function function to call
+     */
+    template <typename F> requires std::invocable<F &>
+    void post(F &&function) {
+        post(*new FunctionHandler<std::decay_t<F>>(std::forward<F>(function)));
+    }
+
+    /**
+     * Wake up the loop if it is waiting for events. Thread safe.
+     * @return true if the loop was waiting
+     */
+    bool wakeup();
+
+    /**
+     * Run a blocking function on a worker thread of the thread pool using co_await and resume on this loop with the
+     * result of the function. Requires #include <coco/platform/ThreadPool.hpp>. Usage:
+     *
+     * auto result = co_await loop.offload([&data] {return compress(data);});
+     *
+     * @param function function to call on a worker thread
+     */
+    template <typename F>
+    [[nodiscard]] auto offload(F &&function);
+
+    /**
+     * Idle handler, gets called in each iteration of the loop before it waits for events, e.g. to run or steal work
+     */
+    class IdleHandler {
+    public:
+        virtual ~IdleHandler() {}
+
+        /**
+         * Handle idle time
+         * @return true if work was done, the loop only polls for new events without blocking then
+         */
+        virtual bool handle() = 0;
+    };
+
+    /**
+        Readiness handler, gets called when a file descriptor that was added using add() becomes ready
+    */
+    class ReadyHandler {
+    public:
+        virtual ~ReadyHandler();
+        virtual void handle(uint32_t events) = 0;
+    };
+
+    /**
+     * Add a file descriptor to the loop
+     * @param fd file descriptor
+     * @param handler handler that gets called when the file descriptor becomes ready
+     * @param events epoll events to wait for, e.g. EPOLLIN or EPOLLOUT
+     * @return true if successful
+     */
+    bool add(int fd, ReadyHandler &handler, uint32_t events = EPOLLIN);
+
+    /**
+     * Modify the events to wait for of a file descriptor that was added using add()
+     * @param fd file descriptor
+     * @param handler handler that gets called when the file descriptor becomes ready
+     * @param events epoll events to wait for
+     * @return true if successful
+     */
+    bool modify(int fd, ReadyHandler &handler, uint32_t events);
+
+    /**
+     * Remove a file descriptor from the loop
+     * @param fd file descriptor
+     */
+    void remove(int fd);
+
+    /**
+     * Watches files and directories for changes using inotify. A burst of events for the same path, i.e. the same
+     * watch descriptor and name, gets coalesced into one change that is reported after the coalescing window has
+     * elapsed since the first event. IN_IGNORED which notifies that a watch was removed is not reported.
+     */
+    class FileWatcher : public ReadyHandler {
+    public:
+        /**
+         * Constructor
+         * @param loop event loop
+         * @param window coalescing window, events for the same path within this time get reported as one change
+         */
+        FileWatcher(Loop_Epoll &loop, Duration window = 100ms);
+        ~FileWatcher() override;
+
+        /**
+         * Watch a file or directory
+         * @param path path of the file or directory
+         * @param mask inotify events to watch for
+         * @return watch descriptor or -1 on error
+         */
+        int watch(const char *path, uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE
+            | IN_DELETE_SELF | IN_MOVE_SELF);
+
+        /**
+         * Stop watching a file or directory
+         * @param wd watch descriptor returned by watch()
+         */
+        void unwatch(int wd);
+
+        /**
+         * Wait for the next change, afterwards the changed path is identified by wd and name and events contains all
+         * inotify events of the burst. After an overflow of the inotify queue, wd is -1 and all paths should be
+         * checked.
+         */
+        [[nodiscard]] Awaitable<> changed();
+
+        // watch descriptor of the changed path
+        int wd = -1;
+
+        // name of the changed file in a watched directory, empty if the watched file or directory itself has changed
+        std::string name;
+
+        // inotify events of the change
+        uint32_t events = 0;
+
+    protected:
+        void handle(uint32_t events) override;
+        void deliver();
+
+        Loop_Epoll &loop;
+        Duration window;
+        int fd;
+        CoroutineTaskList<> tasks;
+
+        // timer for the end of the coalescing window of the first pending change
+        TimedTask<Callback> timer;
+
+        // changes in the order of their first event, the coalescing window of a change has elapsed when its time
+        // is reached
+        struct Change {
+            int wd;
+            std::string name;
+            uint32_t events;
+            Time time;
+        };
+        std::vector<Change> changes;
+    };
+
+    /**
+     * Handle events and wait at most the given number of milliseconds for new events
+     * @param wait maximum time to wait in milliseconds
+     */
+    bool handleEvents(int wait = std::numeric_limits<int>::max() / 2);
+
+    // epoll file descriptor
+    int epollFd;
+
+    // time to spin and poll for new events before blocking, 0 to block right away
+    Microseconds<> spinTime = {0};
+
+    // number of times new events were found while spinning
+    int spinHitCount = 0;
+
+    // number of times the loop had to block, compare with spinHitCount to tune spinTime
+    int blockCount = 0;
+
+    // optional idle handler
+    IdleHandler *idleHandler = nullptr;
+
+    // thread pool for offload(), nullptr to use ThreadPool::shared()
+    ThreadPool *threadPool = nullptr;
+
+protected:
+
+    // handler for functions passed to post(), deletes itself after the function was called
+    template <typename F>
+    class FunctionHandler : public Handler {
+    public:
+        FunctionHandler(F &&function) : function(std::move(function)) {}
+        FunctionHandler(const F &function) : function(function) {}
+        void handle() override {
+            this->function();
+            delete this;
+        }
+
+        F function;
+    };
+
+    // call all posted handlers, returns true if at least one handler was called
+    bool handlePosted();
+
+    /**
+     * Spin for at most spinTime and poll for new events, call posted handlers and ready handlers
+     * @param wait maximum time to wait in milliseconds
+     * @return true if new events were found or a sleep task is due, the loop should not block then
+     */
+    bool spin(int wait);
+
+    /**
+     * Poll for new events without blocking, overridden by Loop_IoUring to check the completion queue
+     * @return true if new events were found
+     */
+    virtual bool poll();
+
+    /**
+     * Arm the timer to the time when the first sleep task is due if this time has changed
+     */
+    void armTimer();
+
+    /**
+     * Wait for file descriptors to become ready and call their handlers
+     * @param timeout timeout in milliseconds
+     * @return true if at least one file descriptor was ready
+     */
+    bool handleReady(int timeout);
+
+    // timer that is armed with absolute time to the first sleep task
+    class TimerHandler : public ReadyHandler {
+    public:
+        void handle(uint32_t events) override;
+
+        Loop_Epoll *loop;
+    };
+    TimerHandler timerHandler;
+    int timerFd;
+    Time timerTime;
+    bool timerArmed = false;
+
+    // add a signal to the signal mask of the signalfd
+    void addSignal(int signo);
+
+    // signalfd that receives the signals for which signal() or invoke() was called
+    class SignalHandler : public ReadyHandler {
+    public:
+        void handle(uint32_t events) override;
+
+        Loop_Epoll *loop;
+    };
+    SignalHandler signalHandler;
+    int signalFd = -1;
+    sigset_t signalMask;
+
+    // signal tasks for each signal number
+    TaskList<Task<Callback>> signalTasks1[NSIG];
+    CoroutineTaskList<> signalTasks2[NSIG];
+
+    // handlers posted from other threads and eventfd for waking up the loop
+    class EventHandler : public ReadyHandler {
+    public:
+        void handle(uint32_t events) override;
+
+        Loop_Epoll *loop;
+    };
+    EventHandler eventHandler;
+    int eventFd;
+    IntrusiveMpscQueue<Handler> postQueue;
+
+    // true while the loop may be blocked waiting for events
+    std::atomic<bool> sleeping = false;
+
+    // sleep tasks
+    TimerStore<TimedTaskList<Callback>> sleepTasks1;
+    TimerStore<CoroutineTimedTaskList> sleepTasks2;
+};
+
+} // namespace coco
@@ -0,0 +1,809 @@
+#include "Loop_IoUring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+
+namespace coco {
+
+namespace {
+
+int io_uring_setup(unsigned entries, io_uring_params *params) {
+	return int(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize) {
+	return int(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+int io_uring_register(int fd, unsigned opcode, const void *arg, unsigned argCount) {
+	return int(syscall(__NR_io_uring_register, fd, opcode, arg, argCount));
+}
+
+// size of a huge page on x86 and arm64
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// allocate a page aligned arena, try huge pages first
+void *allocateArena(size_t size) {
+	void *arena = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (arena == MAP_FAILED) {
+		// no huge pages reserved: use normal pages and ask for transparent huge pages
+		arena = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (arena == MAP_FAILED) {
+			auto e = errno;
+			std::cout << "mmap: " << e << std::endl;
+			return nullptr;
+		}
+		madvise(arena, size, MADV_HUGEPAGE);
+	}
+	return arena;
+}
+
+// the ring indices are shared with the kernel
+unsigned loadAcquire(unsigned *p) {
+	return std::atomic_ref<unsigned>(*p).load(std::memory_order_acquire);
+}
+
+void storeRelease(unsigned *p, unsigned value) {
+	std::atomic_ref<unsigned>(*p).store(value, std::memory_order_release);
+}
+
+} // namespace
+
+
+Loop_IoUring::Loop_IoUring(int entries, Mode mode, Duration idleTime, int cpu) : mode(mode) {
+	this->pollHandler.loop = this;
+
+	// create io_uring
+	io_uring_params params = {};
+	if (mode == Mode::SQPOLL) {
+		params.flags = IORING_SETUP_SQPOLL;
+		params.sq_thread_idle = idleTime.value;
+		if (cpu >= 0) {
+			params.flags |= IORING_SETUP_SQ_AFF;
+			params.sq_thread_cpu = cpu;
+		}
+	}
+	int fd = io_uring_setup(entries, &params);
+	if (fd < 0) {
+		auto e = errno;
+		std::cout << "io_uring_setup: " << e << std::endl;
+		return;
+	}
+	if (!(params.features & IORING_FEAT_EXT_ARG)) {
+		// kernel is too old (5.11 is required for waiting with timeout)
+		std::cout << "io_uring: IORING_FEAT_EXT_ARG not supported" << std::endl;
+		close(fd);
+		return;
+	}
+
+	// map submission and completion queue rings
+	this->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	this->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+	bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMap)
+		this->sqRingSize = this->cqRingSize = std::max(this->sqRingSize, this->cqRingSize);
+	void *sqRing = mmap(nullptr, this->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+		IORING_OFF_SQ_RING);
+	void *cqRing = singleMap ? sqRing : mmap(nullptr, this->cqRingSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	this->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	void *sqes = mmap(nullptr, this->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+		IORING_OFF_SQES);
+	if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+		auto e = errno;
+		std::cout << "io_uring mmap: " << e << std::endl;
+		if (sqRing != MAP_FAILED)
+			munmap(sqRing, this->sqRingSize);
+		if (!singleMap && cqRing != MAP_FAILED)
+			munmap(cqRing, this->cqRingSize);
+		if (sqes != MAP_FAILED)
+			munmap(sqes, this->sqesSize);
+		close(fd);
+		return;
+	}
+	this->ringFd = fd;
+	this->sqRing = sqRing;
+	this->cqRing = singleMap ? nullptr : cqRing;
+	this->sqes = (io_uring_sqe *)sqes;
+
+	// submission queue
+	auto sq = (uint8_t *)sqRing;
+	this->sqHead = (unsigned *)(sq + params.sq_off.head);
+	this->sqTail = (unsigned *)(sq + params.sq_off.tail);
+	this->sqFlags = (unsigned *)(sq + params.sq_off.flags);
+	this->sqMask = *(unsigned *)(sq + params.sq_off.ring_mask);
+	this->sqEntries = *(unsigned *)(sq + params.sq_off.ring_entries);
+	this->sqLocalTail = *this->sqTail;
+
+	// map each index of the submission queue array to the entry with the same index
+	auto array = (unsigned *)(sq + params.sq_off.array);
+	for (unsigned i = 0; i < this->sqEntries; ++i)
+		array[i] = i;
+
+	// completion queue
+	auto cq = (uint8_t *)cqRing;
+	this->cqHead = (unsigned *)(cq + params.cq_off.head);
+	this->cqTail = (unsigned *)(cq + params.cq_off.tail);
+	this->cqMask = *(unsigned *)(cq + params.cq_off.ring_mask);
+	this->cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+	// poll the epoll file descriptor so that handlers added with add() get called
+	this->pollHandler.arm();
+}
+
+Loop_IoUring::~Loop_IoUring() {
+	if (this->arena != nullptr)
+		munmap(this->arena, this->arenaSize);
+	if (this->ringArena != nullptr)
+		munmap(this->ringArena, this->ringArenaSize);
+	if (this->ringFd == -1)
+		return;
+	munmap(this->sqes, this->sqesSize);
+	if (this->cqRing != nullptr)
+		munmap(this->cqRing, this->cqRingSize);
+	munmap(this->sqRing, this->sqRingSize);
+	close(this->ringFd);
+}
+
+void Loop_IoUring::run() {
+	while (!this->exitFlag) {
+		handleEvents();
+	}
+
+	// drain work that is already in flight, e.g. posted handlers and completions that are already queued
+	handleEvents(0);
+	this->exitFlag = false;
+}
+
+io_uring_sqe *Loop_IoUring::getSubmission(CompletionHandler &handler) {
+	if (this->ringFd == -1)
+		return nullptr;
+
+	// check if the submission queue is full
+	if (this->sqLocalTail - loadAcquire(this->sqHead) >= this->sqEntries) {
+		// submit queued entries to make room
+		submit();
+
+		// the kernel poller thread consumes the entries asynchronously, wait until it has made room
+		if (this->mode == Mode::SQPOLL && this->sqLocalTail - loadAcquire(this->sqHead) >= this->sqEntries) {
+			if (io_uring_enter(this->ringFd, 0, 0, IORING_ENTER_SQ_WAIT, nullptr, 0) < 0) {
+				auto e = errno;
+				std::cout << "io_uring_enter: " << e << std::endl;
+			}
+		}
+
+		// still full, e.g. when the kernel refuses new entries because the completion queue has overflown
+		if (this->sqLocalTail - loadAcquire(this->sqHead) >= this->sqEntries)
+			return nullptr;
+	}
+
+	auto sqe = &this->sqes[this->sqLocalTail & this->sqMask];
+	++this->sqLocalTail;
+	memset(sqe, 0, sizeof(io_uring_sqe));
+	sqe->user_data = uint64_t(uintptr_t(&handler));
+	return sqe;
+}
+
+bool Loop_IoUring::registerBuffers(int count, int size) {
+	if (this->ringFd == -1 || this->arena != nullptr)
+		return false;
+
+	// allocate arena
+	size_t arenaSize = (size_t(count) * size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+	void *arena = allocateArena(arenaSize);
+	if (arena == nullptr)
+		return false;
+
+	// register buffers
+	std::vector<iovec> iovecs(count);
+	for (int i = 0; i < count; ++i) {
+		iovecs[i].iov_base = (uint8_t *)arena + i * size;
+		iovecs[i].iov_len = size;
+	}
+	if (io_uring_register(this->ringFd, IORING_REGISTER_BUFFERS, iovecs.data(), count) < 0) {
+		auto e = errno;
+		std::cout << "io_uring_register: " << e << std::endl;
+		munmap(arena, arenaSize);
+		return false;
+	}
+
+	this->arena = (uint8_t *)arena;
+	this->arenaSize = arenaSize;
+	this->bufferSize = size;
+	return true;
+}
+
+bool Loop_IoUring::registerFiles(int count) {
+	if (this->ringFd == -1)
+		return false;
+
+	// register a table of empty entries
+	std::vector<int> fds(count, -1);
+	if (io_uring_register(this->ringFd, IORING_REGISTER_FILES, fds.data(), count) < 0) {
+		auto e = errno;
+		std::cout << "io_uring_register: " << e << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Loop_IoUring::setFile(int index, int fd) {
+	io_uring_files_update update = {};
+	update.offset = index;
+	update.fds = uint64_t(uintptr_t(&fd));
+	if (io_uring_register(this->ringFd, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0) {
+		auto e = errno;
+		std::cout << "io_uring_register: " << e << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool Loop_IoUring::registerBufferRing(int count, int size) {
+	if (this->ringFd == -1 || this->ringArena != nullptr || (count & (count - 1)) != 0)
+		return false;
+
+	// allocate arena for the ring entries followed by the buffers
+	size_t ringSize = (count * sizeof(io_uring_buf) + 4095) & ~size_t(4095);
+	size_t arenaSize = (ringSize + size_t(count) * size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+	void *arena = allocateArena(arenaSize);
+	if (arena == nullptr)
+		return false;
+
+	// register ring as buffer group 0
+	io_uring_buf_reg reg = {};
+	reg.ring_addr = uint64_t(uintptr_t(arena));
+	reg.ring_entries = count;
+	reg.bgid = 0;
+	if (io_uring_register(this->ringFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		auto e = errno;
+		std::cout << "io_uring_register: " << e << std::endl;
+		munmap(arena, arenaSize);
+		return false;
+	}
+
+	this->bufferRing = (io_uring_buf *)arena;
+	this->ringArena = (uint8_t *)arena + ringSize;
+	this->ringArenaSize = arenaSize;
+	this->ringBufferSize = size;
+	this->ringCount = count;
+
+	// provide all buffers to the kernel
+	for (int i = 0; i < count; ++i)
+		releaseRingBuffer(i);
+	return true;
+}
+
+void Loop_IoUring::releaseRingBuffer(int id) {
+	// note: io_uring_buf_ring::bufs can't be used in C++ because the empty struct of __DECLARE_FLEX_ARRAY has size 1
+	auto &buf = this->bufferRing[this->ringTail & (this->ringCount - 1)];
+	buf.addr = uint64_t(uintptr_t(getRingBuffer(id)));
+	buf.len = this->ringBufferSize;
+	buf.bid = id;
+	++this->ringTail;
+
+	// the tail is overlaid with the reserved field of the first entry
+	auto ring = (io_uring_buf_ring *)this->bufferRing;
+	std::atomic_ref<uint16_t>(ring->tail).store(this->ringTail, std::memory_order_release);
+
+	// receive again on all receivers that have stopped because the shared buffer ring was empty
+	while (!this->stalledReceivers.empty()) {
+		auto &receiver = *this->stalledReceivers.begin();
+		receiver.remove();
+		receiver.arm();
+	}
+}
+
+void Loop_IoUring::cancel(CompletionHandler &handler) {
+	if (this->ringFd == -1)
+		return;
+
+	// turn operations of the handler that are not published to the kernel yet into no-ops without handler
+	for (unsigned tail = *this->sqTail; tail != this->sqLocalTail; ++tail) {
+		auto sqe = &this->sqes[tail & this->sqMask];
+		if (sqe->user_data == uint64_t(uintptr_t(&handler))) {
+			memset(sqe, 0, sizeof(io_uring_sqe));
+			sqe->opcode = IORING_OP_NOP;
+		}
+	}
+
+	// cancel synchronously (Linux 6.0)
+	io_uring_sync_cancel_reg reg = {};
+	reg.addr = uint64_t(uintptr_t(&handler));
+	reg.flags = IORING_ASYNC_CANCEL_ALL;
+	reg.timeout.tv_sec = -1;
+	reg.timeout.tv_nsec = -1;
+	if (io_uring_register(this->ringFd, IORING_REGISTER_SYNC_CANCEL, &reg, 1) < 0 && errno == EINVAL) {
+		// fall back to asynchronous cancel which completes inline for poll based operations such as accept and recv
+		auto sqe = getSubmission(handler);
+		if (sqe != nullptr) {
+			sqe->user_data = 0;
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->addr = uint64_t(uintptr_t(&handler));
+			sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+			submit();
+		}
+	}
+
+	// discard completions of the handler that are already queued
+	unsigned tail = loadAcquire(this->cqTail);
+	for (unsigned head = *this->cqHead; head != tail; ++head) {
+		auto &entry = this->cqes[head & this->cqMask];
+		if (entry.user_data == uint64_t(uintptr_t(&handler)))
+			entry.user_data = 0;
+	}
+
+	// discard completions of the handler in the batch that handleEvents() is currently dispatching
+	for (unsigned i = this->batchIndex; i < this->batchCount; ++i) {
+		auto &entry = this->batch[i];
+		if (entry.user_data == uint64_t(uintptr_t(&handler)))
+			entry.user_data = 0;
+	}
+}
+
+int Loop_IoUring::submit() {
+	unsigned toSubmit = publish();
+	if (this->mode == Mode::SQPOLL) {
+		// the kernel poller thread picks up the entries, only wake it up if it went to sleep
+		if (toSubmit > 0 && needsWakeup())
+			io_uring_enter(this->ringFd, 0, 0, IORING_ENTER_SQ_WAKEUP, nullptr, 0);
+		return toSubmit;
+	}
+	if (toSubmit == 0)
+		return 0;
+	int result = io_uring_enter(this->ringFd, toSubmit, 0, 0, nullptr, 0);
+	if (result < 0) {
+		auto e = errno;
+		std::cout << "io_uring_enter: " << e << std::endl;
+		return -e;
+	}
+	return result;
+}
+
+bool Loop_IoUring::handleEvents(int wait) {
+	if (this->ringFd == -1)
+		return Loop_Epoll::handleEvents(wait);
+
+	// don't block if tasks or coroutines wait on invoke() or yield()
+	if (hasYieldTasks())
+		wait = 0;
+
+	// submit queued operations and spin for new events before blocking
+	if (wait > 0 && this->spinTime.value > 0) {
+		submit();
+		if (spin(wait))
+			wait = 0;
+	}
+
+	// call the idle handler and don't block if it has done work
+	if (this->idleHandler != nullptr && this->idleHandler->handle())
+		wait = 0;
+
+	// poll the epoll file descriptor again if the submission queue was full when the poll had to be armed. Until then
+	// the handlers added with add() get polled directly without blocking
+	if (!this->pollHandler.armed) {
+		this->pollHandler.arm();
+		if (!this->pollHandler.armed) {
+			handleReady(0);
+			wait = 0;
+		}
+	}
+
+	// announce that the loop may block, then call posted handlers and don't block if there were any
+	this->sleeping = true;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (handlePosted())
+		wait = 0;
+
+	// arm the timer to the first sleep task, the timer wakes up the ring through the polled epoll file descriptor
+	armTimer();
+
+	// submit all queued operations and wait for completions using one system call
+	unsigned toSubmit = publish();
+	unsigned flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+	bool enter = toSubmit > 0;
+	if (this->mode == Mode::SQPOLL) {
+		// the kernel poller thread picks up the entries, only enter if it went to sleep
+		enter = toSubmit > 0 && needsWakeup();
+		if (enter)
+			flags |= IORING_ENTER_SQ_WAKEUP;
+	}
+	bool ready = *this->cqHead != loadAcquire(this->cqTail);
+	unsigned minComplete = (wait > 0 && !ready) ? 1 : 0;
+	if (minComplete > 0)
+		++this->blockCount;
+	if (enter || minComplete > 0) {
+		__kernel_timespec ts = {wait / 1000, (wait % 1000) * 1000000};
+		io_uring_getevents_arg arg = {};
+		if (wait < std::numeric_limits<int>::max() / 2)
+			arg.ts = uint64_t(uintptr_t(&ts));
+		int r = io_uring_enter(this->ringFd, toSubmit, minComplete, flags, &arg, sizeof(arg));
+		if (r < 0) {
+			// timeout (ETIME) or interrupted by a signal (EINTR)
+			auto e = errno;
+			if (e != ETIME && e != EINTR)
+				std::cout << "io_uring_enter: " << e << std::endl;
+		}
+
+		// the loop may have been waiting, read the clock before the handlers get called
+		if (minComplete > 0)
+			refreshNow();
+	}
+
+	this->sleeping.store(false, std::memory_order_relaxed);
+
+	// call handlers that were posted while waiting
+	handlePosted();
+
+	// drain completions that are available now in batches
+	bool result = false;
+	unsigned head = *this->cqHead;
+	unsigned tail = loadAcquire(this->cqTail);
+	while (head != tail) {
+		// copy a batch of entries and free them in the completion queue before calling the handlers
+		unsigned batchCount = std::min(tail - head, unsigned(std::size(this->batch)));
+		for (unsigned i = 0; i < batchCount; ++i)
+			this->batch[i] = this->cqes[(head + i) & this->cqMask];
+		head += batchCount;
+		storeRelease(this->cqHead, head);
+
+		// one or more operations completed: call handler, a handler may cancel other handlers of the batch
+		this->batchCount = batchCount;
+		for (this->batchIndex = 0; this->batchIndex < this->batchCount;) {
+			auto &entry = this->batch[this->batchIndex++];
+			auto handler = (CompletionHandler *)uintptr_t(entry.user_data);
+			if (handler != nullptr)
+				handler->handle(entry.res, entry.flags);
+		}
+		this->batchCount = 0;
+		result = true;
+	}
+
+	// resume coroutines waiting on yield() and activate yield handlers
+	handleYield();
+
+	// resume coroutines waiting on sleep() and activate time handlers
+	{
+		Time currentTime = refreshNow();
+		int count = this->sleepTasks1.doUntil(currentTime);
+		count += this->sleepTasks2.doUntil(currentTime);
+		countCoalesced(count);
+	}
+
+	return result;
+}
+
+bool Loop_IoUring::poll() {
+	// check the completion queue and the file descriptors that are polled through the ring
+	return *this->cqHead != loadAcquire(this->cqTail) || handleReady(0);
+}
+
+unsigned Loop_IoUring::publish() {
+	// make the entries visible to the kernel
+	storeRelease(this->sqTail, this->sqLocalTail);
+	return this->sqLocalTail - loadAcquire(this->sqHead);
+}
+
+bool Loop_IoUring::needsWakeup() {
+	// full barrier between publishing the tail and reading the flags, otherwise the kernel poller thread may go to
+	// sleep without seeing the new entries
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if ((std::atomic_ref<unsigned>(*this->sqFlags).load(std::memory_order_relaxed) & IORING_SQ_NEED_WAKEUP) == 0)
+		return false;
+	++this->sqPollWakeupCount;
+	return true;
+}
+
+
+// Loop_IoUring::CompletionHandler
+
+Loop_IoUring::CompletionHandler::~CompletionHandler() {
+}
+
+
+// Loop_IoUring::Operation
+
+Loop_IoUring::Operation::~Operation() {
+	this->loop.cancel(*this);
+}
+
+Loop_IoUring::Operation::Completion Loop_IoUring::Operation::read(int fd, void *data, int size, uint64_t offset) {
+	return start(IORING_OP_READ, fd, uint64_t(uintptr_t(data)), size, offset);
+}
+
+Loop_IoUring::Operation::Completion Loop_IoUring::Operation::write(int fd, const void *data, int size,
+	uint64_t offset)
+{
+	return start(IORING_OP_WRITE, fd, uint64_t(uintptr_t(data)), size, offset);
+}
+
+Loop_IoUring::Operation::Completion Loop_IoUring::Operation::readFixed(int file, int buffer, int size,
+	uint64_t offset)
+{
+	return startFixed(IORING_OP_READ_FIXED, file, buffer, size, offset);
+}
+
+Loop_IoUring::Operation::Completion Loop_IoUring::Operation::writeFixed(int file, int buffer, int size,
+	uint64_t offset)
+{
+	return startFixed(IORING_OP_WRITE_FIXED, file, buffer, size, offset);
+}
+
+void Loop_IoUring::Operation::handle(int result, uint32_t flags) {
+	// ignore the completion of a cancelled operation, its result is -ECANCELED already
+	if (this->canceled) {
+		this->canceled = false;
+		return;
+	}
+	this->result = result;
+
+	// resume waiting coroutines
+	this->tasks.doAll();
+}
+
+Loop_IoUring::Operation::Completion Loop_IoUring::Operation::start(uint8_t opcode, int fd, uint64_t address,
+	int size, uint64_t offset)
+{
+	// a cancelled operation may still use the buffer until its completion has arrived
+	auto sqe = this->canceled ? nullptr : this->loop.getSubmission(*this);
+	if (sqe == nullptr) {
+		// submission queue is full or io_uring is not supported: fail without waiting
+		this->result = -EBUSY;
+		return {};
+	}
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = address;
+	sqe->len = size;
+	sqe->off = offset;
+	return {*this};
+}
+
+Loop_IoUring::Operation::Completion Loop_IoUring::Operation::startFixed(uint8_t opcode, int file, int buffer,
+	int size, uint64_t offset)
+{
+	auto sqe = this->canceled ? nullptr : this->loop.getSubmission(*this);
+	if (sqe == nullptr) {
+		this->result = -EBUSY;
+		return {};
+	}
+	sqe->opcode = opcode;
+	sqe->flags = IOSQE_FIXED_FILE;
+	sqe->fd = file;
+	sqe->addr = uint64_t(uintptr_t(this->loop.getBuffer(buffer)));
+	sqe->len = size;
+	sqe->off = offset;
+	sqe->buf_index = buffer;
+	return {*this};
+}
+
+void Loop_IoUring::Operation::cancel() {
+	this->result = -ECANCELED;
+	auto sqe = this->loop.getSubmission(*this);
+	if (sqe == nullptr) {
+		// cancel synchronously which also discards the completion
+		this->loop.cancel(*this);
+		return;
+	}
+
+	// the completion of the cancel operation is not needed, the completion of the cancelled operation gets ignored
+	sqe->user_data = 0;
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = uint64_t(uintptr_t(this));
+	this->canceled = true;
+}
+
+
+// Loop_IoUring::Operation::Completion
+
+bool Loop_IoUring::Operation::Completion::cancel() {
+	if (!inList())
+		return false;
+	remove();
+	this->operation->cancel();
+	return true;
+}
+
+
+// Loop_IoUring::Acceptor
+
+Loop_IoUring::Acceptor::Acceptor(Loop_IoUring &loop, int fd) : loop(loop), listenFd(fd) {
+	arm();
+}
+
+Loop_IoUring::Acceptor::~Acceptor() {
+	this->loop.cancel(*this);
+
+	// close connections nobody has taken
+	for (int i = 0; i < this->pendingCount; ++i) {
+		int fd = this->pending[(this->pendingHead + i) % std::size(this->pending)];
+		if (fd >= 0)
+			close(fd);
+	}
+}
+
+Awaitable<> Loop_IoUring::Acceptor::next() {
+	// check if a connection was accepted while no coroutine was waiting
+	if (this->pendingCount > 0) {
+		this->fd = this->pending[this->pendingHead];
+		this->pendingHead = (this->pendingHead + 1) % std::size(this->pending);
+		--this->pendingCount;
+		return {};
+	}
+
+	// report the error that has stopped accepting
+	if (this->error != 0) {
+		this->fd = this->error;
+		return {};
+	}
+
+	// arm again if the submission queue was full, fail without waiting if it still is
+	if (this->armFailed) {
+		arm();
+		if (this->armFailed)
+			return {};
+	}
+	return {this->tasks};
+}
+
+void Loop_IoUring::Acceptor::arm() {
+	auto sqe = this->loop.getSubmission(*this);
+	this->armFailed = sqe == nullptr;
+	if (sqe == nullptr) {
+		this->fd = -EBUSY;
+		return;
+	}
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = this->listenFd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_CLOEXEC;
+}
+
+void Loop_IoUring::Acceptor::handle(int result, uint32_t flags) {
+	if (!(flags & IORING_CQE_F_MORE)) {
+		if (result >= 0) {
+			// accept again if the kernel has stopped the multishot operation without error
+			arm();
+		} else {
+			// don't accept again after an error such as -EBADF or -EINVAL, which would fail again immediately
+			this->error = result;
+		}
+	}
+
+	if (!this->tasks.empty()) {
+		// pass connection to the waiting coroutine
+		this->fd = result;
+		this->tasks.doFirst();
+	} else if (this->pendingCount < int(std::size(this->pending))) {
+		// store connection until next() is called
+		this->pending[(this->pendingHead + this->pendingCount) % std::size(this->pending)] = result;
+		++this->pendingCount;
+	} else if (result >= 0) {
+		std::cout << "Acceptor: too many pending connections" << std::endl;
+		close(result);
+	}
+}
+
+
+// Loop_IoUring::Receiver
+
+Loop_IoUring::Receiver::Receiver(Loop_IoUring &loop, int fd)
+	: loop(loop), fd(fd), pending(loop.ringCount + 1)
+{
+	arm();
+}
+
+Loop_IoUring::Receiver::~Receiver() {
+	// don't receive again when buffers get released
+	remove();
+	this->loop.cancel(*this);
+
+	// give all buffers back to the buffer ring
+	release();
+	for (int i = 0; i < this->pendingCount; ++i) {
+		auto &result = this->pending[(this->pendingHead + i) % this->pending.size()];
+		if (result.bufferId >= 0)
+			this->loop.releaseRingBuffer(result.bufferId);
+	}
+}
+
+Awaitable<> Loop_IoUring::Receiver::next() {
+	// check if data was received while no coroutine was waiting
+	if (this->pendingCount > 0) {
+		auto &result = this->pending[this->pendingHead];
+		this->size = result.size;
+		this->bufferId = result.bufferId;
+		this->pendingHead = (this->pendingHead + 1) % this->pending.size();
+		--this->pendingCount;
+		return {};
+	}
+
+	// arm again if the submission queue was full, fail without waiting if it still is
+	if (this->armFailed) {
+		arm();
+		if (this->armFailed)
+			return {};
+	}
+	return {this->tasks};
+}
+
+void Loop_IoUring::Receiver::release() {
+	if (this->bufferId >= 0) {
+		this->loop.releaseRingBuffer(this->bufferId);
+		this->bufferId = -1;
+	}
+}
+
+void Loop_IoUring::Receiver::arm() {
+	auto sqe = this->loop.getSubmission(*this);
+	this->armFailed = sqe == nullptr;
+	if (sqe == nullptr) {
+		this->size = -EBUSY;
+		return;
+	}
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = this->fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = 0;
+}
+
+void Loop_IoUring::Receiver::handle(int result, uint32_t flags) {
+	int bufferId = (flags & IORING_CQE_F_BUFFER) ? int(flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+
+	if (!(flags & IORING_CQE_F_MORE)) {
+		if (result == -ENOBUFS) {
+			// buffer ring is empty: receive again when any receiver releases a buffer
+			this->loop.stalledReceivers.add(*this);
+			return;
+		}
+
+		// receive again if the kernel has stopped the multishot operation for another reason
+		if (result > 0)
+			arm();
+	}
+
+	if (!this->tasks.empty()) {
+		// pass data to the waiting coroutine
+		this->size = result;
+		this->bufferId = bufferId;
+		this->tasks.doFirst();
+	} else {
+		// store data until next() is called
+		this->pending[(this->pendingHead + this->pendingCount) % this->pending.size()] = {result, bufferId};
+		++this->pendingCount;
+	}
+}
+
+
+// Loop_IoUring::PollHandler
+
+void Loop_IoUring::PollHandler::arm() {
+	// handleEvents() tries again if the submission queue is full
+	auto sqe = this->loop->getSubmission(*this);
+	this->armed = sqe != nullptr;
+	if (sqe == nullptr)
+		return;
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = this->loop->epollFd;
+	sqe->poll32_events = POLLIN;
+}
+
+void Loop_IoUring::PollHandler::handle(int result, uint32_t flags) {
+	// call handlers of ready file descriptors without waiting
+	this->loop->handleReady(0);
+
+	// poll again
+	arm();
+}
+
+} // namespace coco
@@ -0,0 +1,403 @@
+#pragma once
+
+#include "Loop_Epoll.hpp"
+#include <coco/IntrusiveList.hpp>
+#include <linux/io_uring.h>
+#include <vector>
+
+
+namespace coco {
+
+/**
+ * Implementation of the Loop interface using io_uring on Linux.
+ * Operations are queued using getSubmission() and submitted together with one io_uring_enter() per loop iteration.
+ * File descriptors added with add() keep working because the epoll file descriptor is polled through the ring.
+ * If the kernel does not support io_uring, the loop falls back to epoll and getSubmission() returns nullptr.
+ */
+class Loop_IoUring : public Loop_Epoll {
+public:
+
+    enum class Mode {
+        /// submit operations using io_uring_enter()
+        SUBMIT,
+
+        /// a kernel thread polls the submission queue so that no system call is needed for submission (SQPOLL).
+        /// The thread goes to sleep after the idle time and has to be woken up using io_uring_enter()
+        SQPOLL
+    };
+
+    /**
+     * Constructor
+     * @param entries number of entries of the submission queue
+     * @param mode submission mode
+     * @param idleTime time after which the kernel poller thread goes to sleep in Mode::SQPOLL
+     * @param cpu cpu to pin the kernel poller thread to in Mode::SQPOLL, -1 to let the kernel decide
+     */
+    Loop_IoUring(int entries = 256, Mode mode = Mode::SUBMIT, Duration idleTime = 1000ms, int cpu = -1);
+    ~Loop_IoUring() override;
+
+    void run() override;
+
+
+    /**
+        IO Completion handler
+    */
+    class CompletionHandler {
+    public:
+        virtual ~CompletionHandler();
+
+        /**
+         * Gets called when an operation has completed
+         * @param result result of the operation (cqe.res), negative error code on failure
+         * @param flags completion flags (cqe.flags)
+         */
+        virtual void handle(int result, uint32_t flags) = 0;
+    };
+
+    /**
+     * Get a submission queue entry for a new operation. The entry is cleared and its user_data is set to the handler.
+     * All entries are submitted together at the beginning of the next call to handleEvents() or when submit() is called.
+     * If the queue is full, the queued entries get submitted first to make room.
+     * @param handler handler that gets called when the operation completes
+     * @return submission queue entry to fill in or nullptr if the queue is still full or io_uring is not supported
+     */
+    io_uring_sqe *getSubmission(CompletionHandler &handler);
+
+    /**
+     * Submit all queued operations now
+     * @return number of submitted operations or negative error code
+     */
+    int submit();
+
+    /**
+     * Register a pool of buffers with the kernel so that the pages do not have to be pinned for every operation.
+     * The buffers are allocated in a page aligned arena owned by the loop which uses huge pages if available.
+     * Call once at startup.
+     * @param count number of buffers
+     * @param size size of each buffer in bytes
+     * @return true if successful
+     */
+    bool registerBuffers(int count, int size);
+
+    /**
+     * Get a buffer that was registered using registerBuffers()
+     * @param index index of the buffer
+     * @return pointer to the buffer data
+     */
+    uint8_t *getBuffer(int index) {return this->arena + index * this->bufferSize;}
+
+    /**
+     * Register a table of fixed files with the kernel so that the file descriptor does not have to be looked up for
+     * every operation. All entries are initially empty. Call once at startup.
+     * @param count number of entries in the table
+     * @return true if successful
+     */
+    bool registerFiles(int count);
+
+    /**
+     * Set an entry in the table of fixed files
+     * @param index index in the table
+     * @param fd file descriptor or -1 to clear the entry
+     * @return true if successful
+     */
+    bool setFile(int index, int fd);
+
+    /**
+     * Register a ring of buffers from which the kernel selects a buffer for each receive operation of a Receiver.
+     * The buffers are allocated in a page aligned arena owned by the loop. Call once at startup.
+     * @param count number of buffers, must be a power of two
+     * @param size size of each buffer in bytes
+     * @return true if successful
+     */
+    bool registerBufferRing(int count, int size);
+
+    /**
+     * Get a buffer of the buffer ring
+     * @param id buffer id as reported by the kernel
+     * @return pointer to the buffer data
+     */
+    uint8_t *getRingBuffer(int id) {return this->ringArena + id * this->ringBufferSize;}
+
+    /**
+     * Give a buffer back to the buffer ring so that the kernel can use it again. Receivers that have stopped because
+     * the buffer ring was empty receive again
+     * @param id buffer id
+     */
+    void releaseRingBuffer(int id);
+
+    /**
+     * Cancel all operations of a handler and discard their completions that are already queued, e.g. before the
+     * handler gets destroyed. Operations that are not submitted yet do not get submitted.
+     * @param handler handler of the operations to cancel
+     */
+    void cancel(CompletionHandler &handler);
+
+    /**
+     * Read or write operation that can be awaited by a coroutine
+     */
+    class Operation : public CompletionHandler {
+    public:
+        Operation(Loop_IoUring &loop) : loop(loop) {}
+
+        /**
+         * Destructor, cancels a pending operation
+         */
+        ~Operation() override;
+
+        /**
+         * Awaitable for the completion of an operation that can be cancelled, e.g. by Loop::withTimeout()
+         */
+        class Completion : public Awaitable<> {
+        public:
+            Completion() = default;
+            Completion(Operation &operation) : Awaitable<>(operation.tasks), operation(&operation) {}
+
+            /**
+             * Cancel the operation if a coroutine is still waiting for it. The operation gets cancelled in the kernel
+             * using IORING_OP_ASYNC_CANCEL and its result is -ECANCELED. The data buffer must stay valid until the
+             * completion of the cancelled operation has arrived, until then starting a new operation fails with -EBUSY.
+             * @return true if the operation was cancelled, false if it has completed
+             */
+            bool cancel();
+
+        protected:
+            Operation *operation = nullptr;
+        };
+
+        /**
+         * Read from a file descriptor
+         * @param fd file descriptor
+         * @param data data to read into
+         * @param size size of data
+         * @param offset file offset or -1 for the current position
+         */
+        [[nodiscard]] Completion read(int fd, void *data, int size, uint64_t offset = -1);
+
+        /**
+         * Write to a file descriptor
+         * @param fd file descriptor
+         * @param data data to write
+         * @param size size of data
+         * @param offset file offset or -1 for the current position
+         */
+        [[nodiscard]] Completion write(int fd, const void *data, int size, uint64_t offset = -1);
+
+        /**
+         * Read from a fixed file into a registered buffer
+         * @param file index of file registered using setFile()
+         * @param buffer index of buffer registered using registerBuffers()
+         * @param size number of bytes to read
+         * @param offset file offset or -1 for the current position
+         */
+        [[nodiscard]] Completion readFixed(int file, int buffer, int size, uint64_t offset = -1);
+
+        /**
+         * Write from a registered buffer to a fixed file
+         * @param file index of file registered using setFile()
+         * @param buffer index of buffer registered using registerBuffers()
+         * @param size number of bytes to write
+         * @param offset file offset or -1 for the current position
+         */
+        [[nodiscard]] Completion writeFixed(int file, int buffer, int size, uint64_t offset = -1);
+
+        // result of the last operation, number of bytes transferred or negative error code
+        int result = 0;
+
+    protected:
+        void handle(int result, uint32_t flags) override;
+
+        Completion start(uint8_t opcode, int fd, uint64_t address, int size, uint64_t offset);
+        Completion startFixed(uint8_t opcode, int file, int buffer, int size, uint64_t offset);
+
+        // cancel the operation in the kernel
+        void cancel();
+
+        Loop_IoUring &loop;
+        CoroutineTaskList<> tasks;
+
+        // true while the completion of a cancelled operation has not arrived yet
+        bool canceled = false;
+    };
+
+    /**
+     * Multishot accept: One accept operation stays armed and yields all incoming connections of a listening socket
+     */
+    class Acceptor : public CompletionHandler {
+    public:
+        /**
+         * Constructor, starts accepting connections
+         * @param loop event loop
+         * @param fd listening socket
+         */
+        Acceptor(Loop_IoUring &loop, int fd);
+        ~Acceptor() override;
+
+        /**
+         * Wait for the next connection, afterwards the accepted socket is in fd. After accepting has failed, e.g.
+         * because the listening socket was closed, the error is in fd and next() does not wait anymore
+         */
+        [[nodiscard]] Awaitable<> next();
+
+        // accepted socket or negative error code
+        int fd = -1;
+
+    protected:
+        void arm();
+        void handle(int result, uint32_t flags) override;
+
+        Loop_IoUring &loop;
+        int listenFd;
+        CoroutineTaskList<> tasks;
+
+        // true when the submission queue was full, next() tries again
+        bool armFailed = false;
+
+        // error that has stopped accepting, 0 while accepting
+        int error = 0;
+
+        // connections that were accepted while no coroutine was waiting
+        int pending[32];
+        int pendingHead = 0;
+        int pendingCount = 0;
+    };
+
+    /**
+     * Multishot receive: One receive operation stays armed and yields all data received on a socket. The data is
+     * received into buffers that the kernel selects from the buffer ring (see registerBufferRing()).
+     */
+    class Receiver : public CompletionHandler, public IntrusiveListNode {
+        friend class Loop_IoUring;
+    public:
+        /**
+         * Constructor, starts receiving
+         * @param loop event loop with a registered buffer ring
+         * @param fd socket
+         */
+        Receiver(Loop_IoUring &loop, int fd);
+        ~Receiver() override;
+
+        /**
+         * Wait for the next received data, afterwards data() and size are valid until release() is called
+         */
+        [[nodiscard]] Awaitable<> next();
+
+        /**
+         * Get the received data
+         */
+        uint8_t *data() {return this->loop.getRingBuffer(this->bufferId);}
+
+        /**
+         * Give the buffer of the received data back to the buffer ring, call before the next call to next()
+         */
+        void release();
+
+        // size of the received data, 0 at end of stream or negative error code
+        int size = 0;
+
+    protected:
+        void arm();
+        void handle(int result, uint32_t flags) override;
+
+        Loop_IoUring &loop;
+        int fd;
+        CoroutineTaskList<> tasks;
+
+        // buffer id of the received data, -1 if no buffer
+        int bufferId = -1;
+
+        // true when the submission queue was full, next() tries again
+        bool armFailed = false;
+
+        // data that was received while no coroutine was waiting, bounded by the number of buffers in the ring
+        struct Result {
+            int size;
+            int bufferId;
+        };
+        std::vector<Result> pending;
+        int pendingHead = 0;
+        int pendingCount = 0;
+    };
+
+    /**
+     * Handle events and wait at most the given number of milliseconds for new events
+     * @param wait maximum time to wait in milliseconds
+     */
+    bool handleEvents(int wait = std::numeric_limits<int>::max() / 2);
+
+    // io_uring file descriptor
+    int ringFd = -1;
+
+    // number of times the kernel poller thread had to be woken up in Mode::SQPOLL, use to tune the idle time
+    int sqPollWakeupCount = 0;
+
+protected:
+
+    // publish queued submission queue entries to the kernel and return the number of entries to submit
+    unsigned publish();
+
+    // check if the kernel poller thread needs to be woken up in Mode::SQPOLL
+    bool needsWakeup();
+
+    bool poll() override;
+
+    Mode mode;
+
+    // polls the epoll file descriptor through the ring
+    class PollHandler : public CompletionHandler {
+    public:
+        void arm();
+        void handle(int result, uint32_t flags) override;
+
+        Loop_IoUring *loop;
+
+        // false when the submission queue was full
+        bool armed = false;
+    };
+    PollHandler pollHandler;
+
+    // submission queue
+    void *sqRing = nullptr;
+    size_t sqRingSize = 0;
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqFlags;
+    unsigned sqMask;
+    unsigned sqEntries;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqesSize = 0;
+
+    // tail including entries that were not yet published to the kernel
+    unsigned sqLocalTail = 0;
+
+    // buffer ring for multishot receive
+    io_uring_buf *bufferRing = nullptr;
+    uint8_t *ringArena = nullptr;
+    size_t ringArenaSize = 0;
+    int ringBufferSize = 0;
+    unsigned ringCount = 0;
+    uint16_t ringTail = 0;
+
+    // receivers that have stopped because the buffer ring was empty, they receive again when a buffer gets released
+    IntrusiveList<Receiver> stalledReceivers;
+
+    // arena of registered buffers
+    uint8_t *arena = nullptr;
+    size_t arenaSize = 0;
+    int bufferSize = 0;
+
+    // completion queue
+    void *cqRing = nullptr;
+    size_t cqRingSize = 0;
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned cqMask;
+    io_uring_cqe *cqes;
+
+    // batch of completions that handleEvents() has taken from the completion queue and dispatches, cancel() also
+    // discards the completions of a handler that are still in the batch
+    io_uring_cqe batch[16];
+    unsigned batchIndex = 0;
+    unsigned batchCount = 0;
+};
+
+} // namespace coco
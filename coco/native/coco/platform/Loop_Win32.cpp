@@ -1,4 +1,5 @@
 #include "Loop_Win32.hpp"
+#include <algorithm>
 #include <iterator>
 #include <iostream>
 
@@ -37,10 +38,6 @@ void Loop_Win32::run() {
 	this->exitFlag = false;
 }
 
-//Awaitable<> Loop_Win32::yield() {
-//	return {this->yieldTasks2};
-//}
-
 Loop::Time Loop_Win32::now() {
 	// todo: handle overflow
 	LARGE_INTEGER time;
@@ -48,21 +45,112 @@ Loop::Time Loop_Win32::now() {
 	return Time(time.QuadPart / this->frequency);
 }
 
+Microseconds<int64_t> Loop_Win32::nowMicroseconds() {
+	LARGE_INTEGER time;
+	QueryPerformanceCounter(&time);
+	return {time.QuadPart * 1000 / this->frequency};
+}
+
+Microseconds<> Loop_Win32::resolution() {
+	// frequency is in ticks per millisecond
+	int us = int(1000 / this->frequency);
+	return {us > 1 ? us : 1};
+}
+
 Awaitable<CoroutineTimedTask> Loop_Win32::sleep(Time time) {
-	return {this->sleepTasks2, time};
+	return {this->sleepTasks2.list(time), time};
+}
+
+void Loop_Win32::post(Handler &handler) {
+	this->postQueue.push(handler);
+	wakeup();
+}
+
+bool Loop_Win32::wakeup() {
+	// wake up the loop if it is waiting, only the first wakeup after the loop went to sleep needs the system call
+	if (this->sleeping.exchange(false)) {
+		PostQueuedCompletionStatus(this->port, 0, NULL, nullptr);
+		return true;
+	}
+	return false;
 }
 
 bool Loop_Win32::handleEvents(int wait) {
 	// determine timeout, only sleep if there are no coroutines waiting on yield()
 	int timeout = 0;
-	{
-		Time currentTime = now();
+	if (!hasYieldTasks()) {
+		Time currentTime = refreshNow();
 		Time sleepTime = this->sleepTasks2.getFirstTime(this->sleepTasks1.getFirstTime(currentTime + wait * 1ms));
 		int t = (sleepTime - currentTime).value;
 		timeout = t > 0 ? t : 0;
 	}
 
+	// spin for new events before blocking
+	bool result = spin(timeout);
+	if (result)
+		timeout = 0;
+
+	// call the idle handler and don't block if it has done work
+	if (this->idleHandler != nullptr && this->idleHandler->handle())
+		timeout = 0;
+
+	// announce that the loop may block, then call posted handlers and don't block if there were any
+	this->sleeping = true;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (handlePosted())
+		timeout = 0;
+
 	// wait for io completion
+	if (timeout > 0)
+		++this->blockCount;
+	result |= handleCompletions(timeout);
+	this->sleeping.store(false, std::memory_order_relaxed);
+
+	// call handlers that were posted while waiting
+	handlePosted();
+
+	// resume coroutines waiting on yield() and activate yield handlers
+	handleYield();
+
+	// resume coroutines waiting on sleep() and activate time handlers
+	{
+		// read the clock again as handlers or coroutines waiting on yield() may have been running for a long time
+		Time currentTime = refreshNow();
+		int count = this->sleepTasks1.doUntil(currentTime);
+		count += this->sleepTasks2.doUntil(currentTime);
+		countCoalesced(count);
+	}
+
+	return result;
+}
+
+bool Loop_Win32::spin(int timeout) {
+	if (timeout <= 0 || this->spinTime.value <= 0)
+		return false;
+
+	// spin at most until the timeout has elapsed, then a sleep task is due
+	LARGE_INTEGER time;
+	QueryPerformanceCounter(&time);
+	int64_t start = time.QuadPart;
+	int64_t spinTime = std::min(int64_t(this->spinTime.value) * this->frequency / 1000, int64_t(timeout) * this->frequency);
+	do {
+		// check for posted handlers and completed operations
+		if (handlePosted() || handleCompletions(0)) {
+			++this->spinHitCount;
+			return true;
+		}
+		QueryPerformanceCounter(&time);
+	} while (time.QuadPart - start < spinTime);
+
+	// check if the timeout has elapsed, then a sleep task is due
+	if (spinTime == int64_t(timeout) * this->frequency) {
+		++this->spinHitCount;
+		return true;
+	}
+	return false;
+}
+
+bool Loop_Win32::handleCompletions(int timeout) {
 	ULONG entryCount;
 	OVERLAPPED_ENTRY entries[16];
 	bool result = GetQueuedCompletionStatusEx(
@@ -72,12 +160,20 @@ bool Loop_Win32::handleEvents(int wait) {
 		&entryCount,
 		timeout,
 		false);
+
+	// the loop may have been waiting, read the clock before the handlers get called
+	if (timeout != 0)
+		refreshNow();
+
 	if (result) {
 		// one or more operations completed: call handler
 		for (int i = 0; i < entryCount; ++i) {
 			auto &entry = entries[i];
 			auto handler = (CompletionHandler *)(entry.lpCompletionKey);
-			handler->handle(entry.lpOverlapped);
+
+			// skip wakeup from post()
+			if (handler != nullptr)
+				handler->handle(entry.lpOverlapped);
 		}
 	} else {
 		// timeout
@@ -85,18 +181,16 @@ bool Loop_Win32::handleEvents(int wait) {
 		if (e != WAIT_TIMEOUT)
 			std::cout << "GetQueuedCompletionStatusEx: " << e << std::endl;
 	}
+	return result;
+}
 
-	// resume coroutines waiting on yield() and activate yield handlers
-	//this->yieldTasks1.doAll();
-	//this->yieldTasks2.doAll();
-
-	// resume coroutines waiting on sleep() and activate time handlers
-	{
-		Time currentTime = now();
-		this->sleepTasks1.doUntil(currentTime);
-		this->sleepTasks2.doUntil(currentTime);
+bool Loop_Win32::handlePosted() {
+	bool result = false;
+	Handler *handler;
+	while ((handler = this->postQueue.pop()) != nullptr) {
+		handler->handle();
+		result = true;
 	}
-
 	return result;
 }
 
@@ -2,6 +2,11 @@
 
 #include <coco/Loop.hpp>
 #include <coco/Callback.hpp>
+#include <coco/TimerStore.hpp>
+#include <coco/IntrusiveMpscQueue.hpp>
+#include <atomic>
+#include <concepts>
+#include <utility>
 
 #define NOMINMAX
 #define WIN32_LEAN_AND_MEAN
@@ -16,8 +21,11 @@
 
 namespace coco {
 
+class ThreadPool;
+
 /**
- * Implementation of the Loop interface using Win32 and io completion ports
+ * Implementation of the Loop interface using Win32 and io completion ports.
+ * Optionally the loop spins for spinTime before it blocks to reduce the wakeup latency at the cost of cpu time.
  */
 class Loop_Win32 : public Loop {
 public:
@@ -26,10 +34,12 @@ public:
     ~Loop_Win32() override;
 
     void run() override;
-    //[[nodiscard]] Awaitable<> yield() override;
     [[nodiscard]] Time now() override;
+    [[nodiscard]] Microseconds<int64_t> nowMicroseconds() override;
+    [[nodiscard]] Microseconds<> resolution() override;
     [[nodiscard]] Awaitable<CoroutineTimedTask> sleep(Time time) override;
     using Loop::sleep;
+    using Loop::invoke;
 
 
     void invoke(TimedTask<Callback> &task, Time time) {
@@ -47,6 +57,76 @@ public:
         this->sleepTasks1.add(task);
     }
 
+    /**
+     * Call a task at a given time with a slack. The loop may call the task up to slack later so that timers whose
+     * windows overlap get handled in one wakeup.
+     */
+    void invoke(TimedTask<Callback> &task, Time time, Duration slack) {
+        task.cancelAndSet(coalesce(time, slack));
+        this->sleepTasks1.add(task);
+    }
+
+    void invoke(TimedTask<Callback> &task, Duration duration, Duration slack) {
+        task.cancelAndSet(coalesce(now() + duration, slack));
+        this->sleepTasks1.add(task);
+    }
+
+
+    /**
+     * Handler that can be posted to the loop from other threads
+     */
+    class Handler : public IntrusiveMpscQueueNode {
+    public:
+        virtual ~Handler() {}
+        virtual void handle() = 0;
+    };
+
+    /**
+     * Post a handler to the loop. Thread safe, the handler gets called on the thread that runs the loop. Wakes up
+     * the loop if it is waiting for events, the wakeup is skipped if the loop is awake anyway.
+     * @param handler handler
+     */
+    void post(Handler &handler);
+
+    /**
+     * Post a function to the loop. Thread safe, the function gets called on the thread that runs the loop.
+     * @param function function to call
+     */
+    template <typename F> requires std::invocable<F &>
+    void post(F &&function) {
+        post(*new FunctionHandler<std::decay_t<F>>(std::forward<F>(function)));
+    }
+
+    /**
+     * Wake up the loop if it is waiting for events. Thread safe.
+     * @return true if the loop was waiting
+     */
+    bool wakeup();
+
+    /**
+     * Run a blocking function on a worker thread of the thread pool using co_await and resume on this loop with the
+     * result of the function. Requires #include <coco/platform/ThreadPool.hpp>. Usage:
+     *
+     * auto result = co_await loop.offload([&data] {return compress(data);});
+     *
+     * @param function function to call on a worker thread
+     */
+    template <typename F>
+    [[nodiscard]] auto offload(F &&function);
+
+    /**
+     * Idle handler, gets called in each iteration of the loop before it waits for events, e.g. to run or steal work
+     */
+    class IdleHandler {
+    public:
+        virtual ~IdleHandler() {}
+
+        /**
+         * Handle idle time
+         * @return true if work was done, the loop only polls for new events without blocking then
+         */
+        virtual bool handle() = 0;
+    };
 
     /**
         IO Completion handler
@@ -66,17 +146,58 @@ public:
     // io completion port
     HANDLE port;
 
+    // time to spin and poll for new events before blocking, 0 to block right away
+    Microseconds<> spinTime = {0};
+
+    // number of times new events were found while spinning
+    int spinHitCount = 0;
+
+    // number of times the loop had to block, compare with spinHitCount to tune spinTime
+    int blockCount = 0;
+
+    // optional idle handler
+    IdleHandler *idleHandler = nullptr;
+
+    // thread pool for offload(), nullptr to use ThreadPool::shared()
+    ThreadPool *threadPool = nullptr;
+
 protected:
+
+    // handler for functions passed to post(), deletes itself after the function was called
+    template <typename F>
+    class FunctionHandler : public Handler {
+    public:
+        FunctionHandler(F &&function) : function(std::move(function)) {}
+        FunctionHandler(const F &function) : function(function) {}
+        void handle() override {
+            this->function();
+            delete this;
+        }
+
+        F function;
+    };
+
+    // call all posted handlers, returns true if at least one handler was called
+    bool handlePosted();
+
+    // spin for at most spinTime and poll for new events, returns true if the loop should not block
+    bool spin(int timeout);
+
+    // wait for io completions and call their handlers, returns true if at least one operation completed
+    bool handleCompletions(int timeout);
+
     // frequency for QueryPerformanceCounter
     int64_t frequency;
 
-    // yield tasks
-    //TaskList<Task<Callback>> yieldTasks1;
-    //CoroutineTaskList<> yieldTasks2;
+    // handlers posted from other threads, the loop is woken up by a completion packet without completion key
+    IntrusiveMpscQueue<Handler> postQueue;
+
+    // true while the loop may be blocked waiting for events
+    std::atomic<bool> sleeping = false;
 
     // sleep tasks
-    TimedTaskList<Callback> sleepTasks1;
-    CoroutineTimedTaskList sleepTasks2;
+    TimerStore<TimedTaskList<Callback>> sleepTasks1;
+    TimerStore<CoroutineTimedTaskList> sleepTasks2;
 };
 
 } // namespace coco
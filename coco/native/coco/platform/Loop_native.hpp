@@ -5,4 +5,14 @@
 namespace coco {
 using Loop_native = Loop_Win32;
 }
+#elif defined(__linux__) && defined(COCO_LOOP_IO_URING)
+#include "Loop_IoUring.hpp"
+namespace coco {
+using Loop_native = Loop_IoUring;
+}
+#elif defined(__linux__)
+#include "Loop_Epoll.hpp"
+namespace coco {
+using Loop_native = Loop_Epoll;
+}
 #endif
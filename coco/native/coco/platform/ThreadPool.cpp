@@ -0,0 +1,68 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+
+
+namespace coco {
+
+ThreadPool::ThreadPool(int threadCount) {
+	threadCount = std::max(threadCount, 1);
+	for (int i = 0; i < threadCount; ++i)
+		this->threads.emplace_back([this] {work();});
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->exitFlag = true;
+	}
+	this->condition.notify_all();
+	for (auto &thread : this->threads)
+		thread.join();
+}
+
+ThreadPool &ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::submit(Job &job) {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		job.nextJob = nullptr;
+		if (this->last == nullptr)
+			this->first = &job;
+		else
+			this->last->nextJob = &job;
+		this->last = &job;
+
+		// update metrics
+		int depth = this->depth.load(std::memory_order_relaxed) + 1;
+		this->depth.store(depth, std::memory_order_relaxed);
+		if (depth > this->maxDepth.load(std::memory_order_relaxed))
+			this->maxDepth.store(depth, std::memory_order_relaxed);
+	}
+	this->condition.notify_one();
+}
+
+void ThreadPool::work() {
+	while (true) {
+		Job *job;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->condition.wait(lock, [this] {return this->first != nullptr || this->exitFlag;});
+
+			// exit when all queued jobs have been run
+			if (this->first == nullptr)
+				break;
+			job = this->first;
+			this->first = job->nextJob;
+			if (this->first == nullptr)
+				this->last = nullptr;
+			this->depth.store(this->depth.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+		}
+		this->count.fetch_add(1, std::memory_order_relaxed);
+		job->run();
+	}
+}
+
+} // namespace coco
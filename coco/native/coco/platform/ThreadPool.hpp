@@ -0,0 +1,164 @@
+#pragma once
+
+#include "Loop_native.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace coco {
+
+/**
+ * Bounded pool of worker threads for blocking work such as compression, crypto or synchronous libraries that would
+ * otherwise stall a loop. Jobs are intrusive, therefore nothing gets allocated. Usage from a coroutine:
+ *
+ * auto result = co_await loop.offload([&data] {return compress(data);});
+ */
+class ThreadPool {
+public:
+    /**
+     * Job that runs on a worker thread
+     */
+    class Job {
+    public:
+        virtual ~Job() {}
+        virtual void run() = 0;
+
+    protected:
+        friend class ThreadPool;
+        Job *nextJob = nullptr;
+    };
+
+    /**
+     * Constructor
+     * @param threadCount number of worker threads
+     */
+    explicit ThreadPool(int threadCount = int(std::thread::hardware_concurrency()));
+
+    /**
+     * Destructor, runs the jobs that are still queued and waits until the worker threads have finished
+     */
+    ~ThreadPool();
+
+    /**
+     * Get the thread pool that is shared by all loops that don't have their own
+     */
+    static ThreadPool &shared();
+
+    /**
+     * Submit a job. Thread safe.
+     * @param job job to run on a worker thread
+     */
+    void submit(Job &job);
+
+    /**
+     * Awaitable for offload()
+     * @tparam L loop type
+     * @tparam F function type
+     */
+    template <typename L, typename F>
+    class Offload : public Job, public L::Handler {
+    public:
+        using Result = std::invoke_result_t<F &>;
+
+        Offload(ThreadPool &pool, L &loop, F &&function)
+            : pool(pool), loop(loop), function(std::move(function)) {}
+
+        bool await_ready() {return false;}
+
+        void await_suspend(std::coroutine_handle<> coroutine) {
+            this->coroutine = coroutine;
+            this->pool.submit(*this);
+        }
+
+        Result await_resume() {
+            if constexpr (!std::is_void_v<Result>)
+                return std::move(*this->result);
+        }
+
+        // gets called on a worker thread
+        void run() override {
+            if constexpr (std::is_void_v<Result>)
+                this->function();
+            else
+                this->result.emplace(this->function());
+
+            // resume the coroutine on its loop
+            this->loop.post(static_cast<typename L::Handler &>(*this));
+        }
+
+        // gets called on the loop
+        void handle() override {
+            this->coroutine.resume();
+        }
+
+    protected:
+        ThreadPool &pool;
+        L &loop;
+        F function;
+        std::optional<std::conditional_t<std::is_void_v<Result>, char, Result>> result;
+        std::coroutine_handle<> coroutine;
+    };
+
+    /**
+     * Run a function on a worker thread using co_await and resume on the given loop with the result of the function
+     * @param loop loop on which the coroutine gets resumed
+     * @param function function to call on a worker thread
+     */
+    template <typename L, typename F>
+    [[nodiscard]] Offload<L, std::decay_t<F>> offload(L &loop, F &&function) {
+        return {*this, loop, std::decay_t<F>(std::forward<F>(function))};
+    }
+
+    /**
+     * Get the number of jobs that wait for a worker thread
+     */
+    int queueDepth() {return this->depth.load(std::memory_order_relaxed);}
+
+    /**
+     * Get the maximum number of jobs that have waited for a worker thread at the same time
+     */
+    int maxQueueDepth() {return this->maxDepth.load(std::memory_order_relaxed);}
+
+    /**
+     * Get the number of jobs that have been taken by a worker thread
+     */
+    int jobCount() {return this->count.load(std::memory_order_relaxed);}
+
+protected:
+    void work();
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    Job *first = nullptr;
+    Job *last = nullptr;
+    bool exitFlag = false;
+    std::vector<std::thread> threads;
+
+    // metrics
+    std::atomic<int> depth = 0;
+    std::atomic<int> maxDepth = 0;
+    std::atomic<int> count = 0;
+};
+
+#ifdef _WIN32
+template <typename F>
+auto Loop_Win32::offload(F &&function) {
+    auto &pool = this->threadPool != nullptr ? *this->threadPool : ThreadPool::shared();
+    return pool.offload(*this, std::forward<F>(function));
+}
+#elif defined(__linux__)
+template <typename F>
+auto Loop_Epoll::offload(F &&function) {
+    auto &pool = this->threadPool != nullptr ? *this->threadPool : ThreadPool::shared();
+    return pool.offload(*this, std::forward<F>(function));
+}
+#endif
+
+} // namespace coco
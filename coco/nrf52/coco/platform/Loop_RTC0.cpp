@@ -29,14 +29,14 @@ Loop_RTC0::~Loop_RTC0() {
 }
 
 void Loop_RTC0::run() {
-	Time currentTime = now();
+	Time currentTime = refreshNow();
 	while (!this->exitFlag) {
 		// get sleep time (point in time when the first task is due)
 		Time sleepTime = this->sleepTasks2.getFirstTime(this->sleepTasks1.getFirstTime(currentTime + MAX_SLEEP * 1ms/*Duration::max() / 2*/));
 
 		// wait for event if sleep time has not yet passed
 		// see http://infocenter.arm.com/help/index.jsp?topic=/com.arm.doc.dai0321a/BIHICBGB.html
-		if (this->mode == Mode::WAIT) {
+		if (this->mode == Mode::WAIT && !hasYieldTasks() && !this->handlerPending) {
 			// set new timeout and clear pending interrupt flags at peripheral and NVIC
 			int32_t timeout = ((sleepTime.value - this->baseTime) << (7 + 4)) / 125 + 1; // sleep for one count longer ...
 			NRF_RTC0->CC[0] = timeout;
@@ -56,22 +56,39 @@ void Loop_RTC0::run() {
 			}
 		}
 
-		// call handlers
-		Handler *handler;
-		while ((handler = this->handlerQueue.pop()) != nullptr) {
-			handler->handle();
-		}
+		// call handlers of finished device operations within the handler budget
+		handleQueue();
+
+		// resume coroutines waiting on yield() and activate yield handlers
+		handleYield();
 
 		// resume coroutines waiting on sleep()
-		currentTime = now();
-		this->sleepTasks1.doUntil(currentTime);
-		this->sleepTasks2.doUntil(currentTime);
+		currentTime = refreshNow();
+		int count = this->sleepTasks1.doUntil(currentTime);
+		count += this->sleepTasks2.doUntil(currentTime);
+		countCoalesced(count);
 	}
 	this->exitFlag = false;
 }
 
 Loop::Time Loop_RTC0::now() {
 	// time resolution 1/1000 s
+	uint32_t counter = readCounter();
+	return Time(this->baseTime + ((counter * 125) >> (7 + 4)));
+}
+
+Microseconds<int64_t> Loop_RTC0::nowMicroseconds() {
+	// time resolution 1/16384 s
+	uint32_t counter = readCounter();
+	return {int64_t(this->baseTime) * 1000 + ((int64_t(counter) * 15625) >> 8)};
+}
+
+Microseconds<> Loop_RTC0::resolution() {
+	// 1/16384 s
+	return {61};
+}
+
+uint32_t Loop_RTC0::readCounter() {
 	uint32_t counter = NRF_RTC0->COUNTER;
 	if (NRF_RTC0->EVENTS_OVRFLW) {
 		NRF_RTC0->EVENTS_OVRFLW = 0;
@@ -82,11 +99,11 @@ Loop::Time Loop_RTC0::now() {
 		// advance base time by one interval (1024 seconds)
 		this->baseTime += INTERVAL;
 	}
-	return Time(this->baseTime + ((counter * 125) >> (7 + 4)));
+	return counter;
 }
 
 Awaitable<CoroutineTimedTask> Loop_RTC0::sleep(Time time) {
-	return {this->sleepTasks2, time};
+	return {this->sleepTasks2.list(time), time};
 }
 
 } // namespace coco
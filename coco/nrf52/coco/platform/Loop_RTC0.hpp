@@ -38,10 +38,15 @@ public:
 
 	void run() override;
 	[[nodiscard]] Time now() override;
+	[[nodiscard]] Microseconds<int64_t> nowMicroseconds() override;
+	[[nodiscard]] Microseconds<> resolution() override;
 	[[nodiscard]] Awaitable<CoroutineTimedTask> sleep(Time time) override;
 	using Loop::sleep;
 
 protected:
+	// read the RTC counter and advance the base time on overflow
+	uint32_t readCounter();
+
 	Mode mode;
 
 	// base time for now() because the RTC counter is only 24 bit and runs at 16384Hz
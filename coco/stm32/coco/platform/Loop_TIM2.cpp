@@ -46,14 +46,14 @@ void Loop_TIM2::run() {
 	//IWDG->KR = 0x5555;
 	//while (IWDG->SR != 0);
 
-	Time currentTime = now();
+	Time currentTime = refreshNow();
 	while (!this->exitFlag) {
 		// restart watchdog
 		IWDG->KR = 0xAAAA;
 
 		// wait for event if sleep time has not yet passed
 		// see http://infocenter.arm.com/help/index.jsp?topic=/com.arm.doc.dai0321a/BIHICBGB.html
-		if (this->mode == Mode::WAIT) {
+		if (this->mode == Mode::WAIT && !hasYieldTasks() && !this->handlerPending) {
 			// get sleep time
 			Time sleepTime = this->sleepTasks2.getFirstTime(this->sleepTasks1.getFirstTime(currentTime + MAX_SLEEP * 1ms));
 
@@ -75,16 +75,17 @@ void Loop_TIM2::run() {
 			}
 		}
 
-		// call all handlers
-		Handler *handler;
-		while ((handler = this->handlerQueue.pop()) != nullptr) {
-			handler->handle();
-		}
+		// call handlers of finished device operations within the handler budget
+		handleQueue();
+
+		// resume coroutines waiting on yield() and activate yield handlers
+		handleYield();
 
 		// resume coroutines waiting on sleep()
-		currentTime = now();
-		this->sleepTasks1.doUntil(currentTime);
-		this->sleepTasks2.doUntil(currentTime);
+		currentTime = refreshNow();
+		int count = this->sleepTasks1.doUntil(currentTime);
+		count += this->sleepTasks2.doUntil(currentTime);
+		countCoalesced(count);
 	}
 	this->exitFlag = false;
 }
@@ -94,7 +95,7 @@ Loop::Time Loop_TIM2::now() {
 }
 
 Awaitable<CoroutineTimedTask> Loop_TIM2::sleep(Time time) {
-	return {this->sleepTasks2, time};
+	return {this->sleepTasks2.list(time), time};
 }
 
 } // namespace coco
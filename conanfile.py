@@ -1,6 +1,6 @@
 from conan import ConanFile
 from conan.tools.files import copy
-from conan.tools.cmake import CMake
+from conan.tools.cmake import CMake, CMakeToolchain
 
 
 class Project(ConanFile):
@@ -9,13 +9,22 @@ class Project(ConanFile):
     license = "MIT"
     settings = "os", "compiler", "build_type", "arch"
     options = {
-        "platform": [None, "ANY"]}
+        "platform": [None, "ANY"],
+        "io_uring": [True, False],
+        "timers": ["list", "wheel", "heap"]}
     default_options = {
-        "platform": None}
-    generators = "CMakeDeps", "CMakeToolchain"
+        "platform": None,
+        "io_uring": False,
+        "timers": "list"}
+    generators = "CMakeDeps"
     exports_sources = "conanfile.py", "CMakeLists.txt", "coco/*", "test/*"
 
 
+    def config_options(self):
+        # io_uring is only available on Linux
+        if self.settings.os != "Linux":
+            del self.options.io_uring
+
     # check if we are cross compiling
     def cross(self):
         if hasattr(self, "settings_build"):
@@ -32,6 +41,12 @@ class Project(ConanFile):
         self.tool_requires("coco-toolchain/0.3.0", options={"platform": self.options.platform})
         self.test_requires("coco-devboards/0.6.0", options={"platform": self.options.platform})
 
+    def generate(self):
+        toolchain = CMakeToolchain(self)
+        toolchain.cache_variables["COCO_LOOP_IO_URING"] = bool(self.options.get_safe("io_uring"))
+        toolchain.cache_variables["COCO_LOOP_TIMERS"] = str(self.options.timers).upper()
+        toolchain.generate()
+
     keep_imports = True
     def imports(self):
         # copy dependent libraries into the build folder
@@ -54,3 +69,7 @@ class Project(ConanFile):
 
     def package_info(self):
         self.cpp_info.libs = [self.name]
+        if self.options.get_safe("io_uring"):
+            self.cpp_info.defines.append("COCO_LOOP_IO_URING")
+        if self.options.timers != "list":
+            self.cpp_info.defines.append("COCO_LOOP_TIMERS_" + str(self.options.timers).upper())
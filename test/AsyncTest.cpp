@@ -0,0 +1,120 @@
+#include <coco/Async.hpp>
+#include <algorithm>
+#include <vector>
+#include "Check.hpp"
+
+using namespace coco;
+
+
+// Checks the synchronization primitives for coroutines on one loop, returns nonzero on failure
+
+
+// the lock gets passed to the waiting coroutines in FIFO order
+Coroutine lockAndWait(AsyncMutex &mutex, CoroutineTaskList<> &gate, int id, std::vector<int> &order) {
+	co_await mutex.lock();
+	order.push_back(id);
+	co_await Awaitable<>(gate);
+	mutex.unlock();
+}
+
+void testMutex() {
+	AsyncMutex mutex;
+	CoroutineTaskList<> gate;
+	std::vector<int> order;
+	lockAndWait(mutex, gate, 1, order);
+	lockAndWait(mutex, gate, 2, order);
+	lockAndWait(mutex, gate, 3, order);
+	check(order == std::vector<int>({1}), "mutex is locked by the first coroutine");
+	check(!mutex.tryLock(), "tryLock() fails while locked");
+
+	// each unlock resumes the next coroutine which then owns the lock
+	gate.doFirst();
+	check(order == std::vector<int>({1, 2}) && mutex.isLocked(), "lock is passed to the second coroutine");
+	gate.doFirst();
+	gate.doFirst();
+	check(order == std::vector<int>({1, 2, 3}), "mutex waiters are resumed in FIFO order");
+	check(!mutex.isLocked() && mutex.tryLock(), "mutex is unlocked at the end");
+}
+
+// at most count coroutines hold a permit at the same time
+Coroutine acquireAndWait(AsyncSemaphore &semaphore, CoroutineTaskList<> &gate, int &holding, int &maxHolding) {
+	co_await semaphore.acquire();
+	++holding;
+	maxHolding = std::max(maxHolding, holding);
+	co_await Awaitable<>(gate);
+	--holding;
+	semaphore.release();
+}
+
+void testSemaphore() {
+	AsyncSemaphore semaphore(2);
+	CoroutineTaskList<> gate;
+	int holding = 0;
+	int maxHolding = 0;
+	for (int i = 0; i < 5; ++i)
+		acquireAndWait(semaphore, gate, holding, maxHolding);
+	check(holding == 2 && semaphore.available() == 0, "two coroutines hold a permit");
+	while (!gate.empty())
+		gate.doFirst();
+	check(maxHolding == 2, "no more than two coroutines hold a permit");
+	check(holding == 0 && semaphore.available() == 2, "all permits are released");
+}
+
+// all coroutines continue when the last one has arrived, the barrier is used for several phases
+Coroutine arriveAndWait(AsyncBarrier &barrier, CoroutineTaskList<> &gate, int &phase) {
+	for (int i = 0; i < 3; ++i) {
+		co_await Awaitable<>(gate);
+		co_await barrier.arrive();
+		++phase;
+	}
+}
+
+void testBarrier() {
+	AsyncBarrier barrier(3);
+	CoroutineTaskList<> gate;
+	int phases[3] = {};
+	for (int i = 0; i < 3; ++i)
+		arriveAndWait(barrier, gate, phases[i]);
+	for (int phase = 1; phase <= 3; ++phase) {
+		// the first two coroutines wait at the barrier
+		gate.doFirst();
+		gate.doFirst();
+		check(phases[0] == phase - 1 && phases[1] == phase - 1, "coroutines wait at the barrier");
+
+		// the last one lets all continue
+		gate.doFirst();
+		check(phases[0] == phase && phases[1] == phase && phases[2] == phase, "all coroutines pass the barrier");
+	}
+}
+
+// all waiting coroutines continue when the event is set
+Coroutine waitEvent(AsyncEvent &event, int &count) {
+	co_await event.wait();
+	++count;
+}
+
+void testEvent() {
+	AsyncEvent event;
+	int count = 0;
+	waitEvent(event, count);
+	waitEvent(event, count);
+	check(count == 0, "coroutines wait until the event is set");
+	event.set();
+	check(count == 2, "all coroutines continue when the event is set");
+	waitEvent(event, count);
+	check(count == 3, "no wait while the event is set");
+	event.reset();
+	waitEvent(event, count);
+	check(count == 3, "coroutines wait again after reset");
+	event.set();
+	check(count == 4, "coroutine continues when the event is set again");
+}
+
+int main() {
+	testMutex();
+	testSemaphore();
+	testBarrier();
+	testEvent();
+
+	return result();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <iostream>
+
+
+// Result of the tests for the native platform, a test returns nonzero on failure
+
+inline int failCount = 0;
+
+/**
+ * Count a failure and print its message if the condition does not hold
+ * @param condition condition that has to hold
+ * @param message message describing the condition
+ */
+inline void check(bool condition, const char *message) {
+	if (!condition) {
+		std::cout << "failed: " << message << std::endl;
+		++failCount;
+	}
+}
+
+/**
+ * Print the result of the test
+ * @return exit code of the test, nonzero on failure
+ */
+inline int result() {
+	std::cout << (failCount == 0 ? "passed" : "FAILED") << std::endl;
+	return failCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include <coco/platform/Loop_IoUring.hpp>
+#include <iostream>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace coco;
+
+
+// Compares reads and writes using registered buffers and fixed files against plain reads and writes on a loopback
+// socket
+
+constexpr int BUFFER_SIZE = 4096;
+constexpr int COUNT = 100000;
+
+// connect two sockets over the loopback interface
+bool connectLoopback(int &client, int &server) {
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t length = sizeof(address);
+	if (bind(listener, (sockaddr *)&address, length) != 0 || listen(listener, 1) != 0
+		|| getsockname(listener, (sockaddr *)&address, &length) != 0)
+	{
+		close(listener);
+		return false;
+	}
+	client = socket(AF_INET, SOCK_STREAM, 0);
+	int one = 1;
+	setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if (connect(client, (sockaddr *)&address, length) != 0) {
+		close(listener);
+		return false;
+	}
+	server = accept(listener, nullptr, nullptr);
+	close(listener);
+	return server != -1;
+}
+
+// ping-pong a buffer between client and server using plain reads and writes
+Coroutine plain(Loop_IoUring &loop, int client, int server, bool &done) {
+	Loop_IoUring::Operation writer(loop);
+	Loop_IoUring::Operation reader(loop);
+	uint8_t writeData[BUFFER_SIZE] = {};
+	uint8_t readData[BUFFER_SIZE];
+
+	auto start = loop.now();
+	for (int i = 0; i < COUNT; ++i) {
+		co_await writer.write(client, writeData, BUFFER_SIZE);
+		int size = 0;
+		while (size < BUFFER_SIZE) {
+			co_await reader.read(server, readData + size, BUFFER_SIZE - size);
+			if (reader.result <= 0)
+				break;
+			size += reader.result;
+		}
+	}
+	auto duration = loop.now() - start;
+	std::cout << "plain: " << duration.value << "ms" << std::endl;
+	done = true;
+}
+
+// ping-pong a buffer between client and server using registered buffers and fixed files
+Coroutine fixed(Loop_IoUring &loop, bool &done) {
+	Loop_IoUring::Operation writer(loop);
+	Loop_IoUring::Operation reader(loop);
+
+	auto start = loop.now();
+	for (int i = 0; i < COUNT; ++i) {
+		co_await writer.writeFixed(0, 0, BUFFER_SIZE);
+		int size = 0;
+		while (size < BUFFER_SIZE) {
+			co_await reader.readFixed(1, 1, BUFFER_SIZE - size);
+			if (reader.result <= 0)
+				break;
+			size += reader.result;
+		}
+	}
+	auto duration = loop.now() - start;
+	std::cout << "registered buffers and fixed files: " << duration.value << "ms" << std::endl;
+	done = true;
+}
+
+int main() {
+	Loop_IoUring loop;
+	int client, server;
+	if (!connectLoopback(client, server)) {
+		std::cout << "loopback connection failed" << std::endl;
+		return 1;
+	}
+
+	// plain
+	bool done = false;
+	plain(loop, client, server, done);
+	while (!done)
+		loop.handleEvents();
+
+	// registered buffers and fixed files
+	if (!loop.registerBuffers(2, BUFFER_SIZE) || !loop.registerFiles(2)) {
+		std::cout << "registration failed" << std::endl;
+		return 1;
+	}
+	loop.setFile(0, client);
+	loop.setFile(1, server);
+	done = false;
+	fixed(loop, done);
+	while (!done)
+		loop.handleEvents();
+
+	close(client);
+	close(server);
+	return 0;
+}
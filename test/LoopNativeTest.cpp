@@ -0,0 +1,612 @@
+#include <coco/platform/Loop_native.hpp>
+#include <coco/platform/ThreadPool.hpp>
+#include <coco/Async.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include "Check.hpp"
+
+using namespace coco;
+
+
+// Checks the behavior of the native loop, returns nonzero on failure
+
+Coroutine sleepAndExit(Loop &loop, Loop::Duration duration) {
+	co_await loop.sleep(duration);
+	loop.exit();
+}
+
+
+// the cached time gets refreshed after the loop has been waiting, before the handlers get called
+void testCachedNow() {
+	Loop_native loop;
+	int lag = -1;
+	std::thread thread([&loop, &lag] {
+		// post while the loop is waiting
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		loop.post([&loop, &lag] {
+			lag = (loop.now() - loop.cachedNow()).value;
+			loop.exit();
+		});
+	});
+	loop.run();
+	thread.join();
+	check(lag >= 0 && lag < 50, "cachedNow() is refreshed after waiting");
+}
+
+// handlers posted from other threads all get called exactly once on the loop thread
+void testPost() {
+	constexpr int THREAD_COUNT = 4;
+	constexpr int POST_COUNT = 10000;
+	Loop_native loop;
+	auto loopThread = std::this_thread::get_id();
+	int count = 0;
+	bool wrongThread = false;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < THREAD_COUNT; ++i) {
+		threads.emplace_back([&] {
+			for (int j = 0; j < POST_COUNT; ++j) {
+				loop.post([&] {
+					if (std::this_thread::get_id() != loopThread)
+						wrongThread = true;
+					if (++count == THREAD_COUNT * POST_COUNT)
+						loop.exit();
+				});
+
+				// let the loop go to sleep sometimes so that wakeup() has to write to the eventfd
+				if (j % 1000 == 0)
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+	loop.run();
+	for (auto &thread : threads)
+		thread.join();
+	check(count == THREAD_COUNT * POST_COUNT, "all posted handlers get called");
+	check(!wrongThread, "posted handlers get called on the loop thread");
+}
+
+// timers with slack whose windows overlap get handled in one wakeup, never early and at most slack late
+Coroutine sleepWithSlack(Loop &loop, Loop::Time time, Loop::Duration slack, Loop::Time &resumeTime) {
+	co_await loop.sleep(time, slack);
+	resumeTime = loop.now();
+}
+
+void testSlack() {
+	Loop_native loop;
+
+	// start on a multiple of 64ms so that the windows don't depend on the current time
+	auto base = Loop::Time(int(unsigned(loop.now().value + 127) & ~63u));
+	Loop::Time resumeTime1;
+	Loop::Time resumeTime2;
+	Loop::Time resumeTime3;
+	sleepWithSlack(loop, base + 1ms, 32ms, resumeTime1);
+	sleepWithSlack(loop, base + 20ms, 32ms, resumeTime2);
+	sleepWithSlack(loop, base + 40ms, 0ms, resumeTime3);
+	check(loop.coalescedCount == 0, "timers get counted when they fire");
+	sleepAndExit(loop, (base - loop.now()) + 100ms);
+	loop.run();
+	check(loop.coalescedCount == 1, "overlapping windows get coalesced");
+	check(resumeTime2 - resumeTime1 <= 1ms, "coalesced timers resume in the same wakeup");
+	check(resumeTime1 >= base + 20ms && resumeTime1 < base + 1ms + 32ms + 20ms, "coalesced timers resume in their window");
+	check(resumeTime3 >= base + 40ms, "timer without slack is not early");
+}
+
+// the ticks of a periodic timer after the first tick has been overrun by two and a half periods
+Coroutine tickAndOverrun(Loop &loop, Loop::Periodic::Policy policy, std::vector<int> &offsets,
+	std::vector<int> &missed)
+{
+	auto start = loop.now();
+	auto ticker = loop.periodic(100ms, policy);
+	for (int i = 0; i < 5; ++i) {
+		co_await ticker.next();
+		offsets.push_back((loop.now() - start).value);
+		missed.push_back(ticker.missed);
+
+		// block the loop until 360ms, the tick at 200ms is late and the tick at 300ms is missed
+		if (i == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(260));
+	}
+	loop.exit();
+}
+
+void testPeriodic(Loop::Periodic::Policy policy, std::vector<int> expectedOffsets, std::vector<int> expectedMissed,
+	const char *name)
+{
+	Loop_native loop;
+	std::vector<int> offsets;
+	std::vector<int> missed;
+	tickAndOverrun(loop, policy, offsets, missed);
+	loop.run();
+	bool inTime = offsets.size() == expectedOffsets.size();
+	for (size_t i = 0; inTime && i < offsets.size(); ++i)
+		inTime = offsets[i] >= expectedOffsets[i] && offsets[i] < expectedOffsets[i] + 40;
+	check(inTime, name);
+	check(missed == expectedMissed, name);
+}
+
+// a period of zero gets clamped to 1ms, also when the ticks are overrun
+Coroutine tickZeroPeriod(Loop &loop, int &count) {
+	auto ticker = loop.periodic(0ms);
+	for (int i = 0; i < 3; ++i) {
+		co_await ticker.next();
+		++count;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	loop.exit();
+}
+
+void testZeroPeriod() {
+	Loop_native loop;
+	int count = 0;
+	tickZeroPeriod(loop, count);
+	loop.run();
+	check(count == 3, "periodic with zero period");
+}
+
+// withTimeout() yields false and cancels the awaitable on timeout, true and cancels the timer on completion
+Coroutine waitWithTimeout(Loop &loop, AsyncEvent &event, Loop::Duration timeout, int &result) {
+	result = co_await loop.withTimeout(event.wait(), timeout) ? 1 : 0;
+}
+
+Coroutine setLater(Loop &loop, AsyncEvent &event, Loop::Duration delay) {
+	co_await loop.sleep(delay);
+	event.set();
+}
+
+void testTimeout() {
+	static_assert(CancelableAwaitable<Awaitable<>>);
+	static_assert(CancelableAwaitable<Awaitable<CoroutineTimedTask>>);
+	Loop_native loop;
+
+	// timeout
+	AsyncEvent event1;
+	int result1 = -1;
+	waitWithTimeout(loop, event1, 20ms, result1);
+	setLater(loop, event1, 50ms);
+
+	// completion
+	AsyncEvent event2;
+	int result2 = -1;
+	waitWithTimeout(loop, event2, 500ms, result2);
+	setLater(loop, event2, 20ms);
+
+	sleepAndExit(loop, 100ms);
+	loop.run();
+	check(result1 == 0, "withTimeout() times out");
+	check(result2 == 1, "withTimeout() completes");
+}
+
+// offload() runs blocking functions on the worker threads while the loop keeps running
+Coroutine offloadWork(Loop_native &loop, int i, std::thread::id loopThread, int &sum, int &wrongThreadCount,
+	int &count)
+{
+	int result = co_await loop.offload([i, loopThread, &wrongThreadCount] {
+		if (std::this_thread::get_id() == loopThread)
+			++wrongThreadCount;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		return i * i;
+	});
+	if (std::this_thread::get_id() != loopThread)
+		++wrongThreadCount;
+	sum += result;
+
+	// function without result
+	co_await loop.offload([] {});
+	if (--count == 0)
+		loop.exit();
+}
+
+Coroutine sleepDuringOffload(Loop &loop, Loop::Time &resumeTime) {
+	co_await loop.sleep(20ms);
+	resumeTime = loop.now();
+}
+
+void testOffload() {
+	constexpr int COUNT = 8;
+	Loop_native loop;
+	ThreadPool pool(2);
+	loop.threadPool = &pool;
+	int sum = 0;
+	int wrongThreadCount = 0;
+	int count = COUNT;
+	auto start = loop.now();
+	for (int i = 0; i < COUNT; ++i)
+		offloadWork(loop, i, std::this_thread::get_id(), sum, wrongThreadCount, count);
+	Loop::Time resumeTime;
+	sleepDuringOffload(loop, resumeTime);
+	loop.run();
+	check(sum == 140, "results of the offloaded functions");
+	check(wrongThreadCount == 0, "functions run on the worker threads, coroutines resume on the loop");
+	check(pool.jobCount() == 2 * COUNT, "all jobs were run");
+	check(pool.maxQueueDepth() > 0, "jobs wait for a worker thread");
+	check(resumeTime - start < 50ms, "loop is not blocked by offloaded functions");
+}
+
+// coroutines waiting on yield() get resumed in FIFO order after the tasks passed to invoke()
+Coroutine yieldSteps(Loop &loop, int id, std::vector<int> &order) {
+	for (int i = 0; i < 3; ++i) {
+		co_await loop.yield();
+		order.push_back(id);
+	}
+	if (id == 3)
+		loop.exit();
+}
+
+struct Recorder {
+	void call() {this->order.push_back(0);}
+	std::vector<int> &order;
+};
+
+void testYieldOrder() {
+	Loop_native loop;
+	std::vector<int> order;
+	Recorder recorder{order};
+	Task<Callback> task(makeCallback<&Recorder::call>(&recorder));
+	yieldSteps(loop, 1, order);
+	yieldSteps(loop, 2, order);
+	yieldSteps(loop, 3, order);
+	loop.invoke(task);
+	loop.run();
+	check(order == std::vector<int>({0, 1, 2, 3, 1, 2, 3, 1, 2, 3}), "yield() order");
+}
+
+// a coroutine that keeps yielding must not starve the sleep tasks
+Coroutine yieldForever(Loop &loop, bool &stop, bool &timeout) {
+	auto end = loop.now() + 2s;
+	while (!stop) {
+		co_await loop.yield();
+		if (loop.now() > end) {
+			timeout = true;
+			loop.exit();
+			break;
+		}
+	}
+}
+
+Coroutine sleepAndStop(Loop &loop, bool &stop) {
+	co_await loop.sleep(50ms);
+	stop = true;
+	loop.exit();
+}
+
+void testYieldStarvation() {
+	Loop_native loop;
+	bool stop = false;
+	bool timeout = false;
+	yieldForever(loop, stop, timeout);
+	sleepAndStop(loop, stop);
+	loop.run();
+	check(stop && !timeout, "sleep() finishes while a coroutine keeps yielding");
+}
+
+#ifdef __linux__
+// signals arrive as loop events, both for coroutines and for tasks
+Coroutine waitSignal(Loop_native &loop, int signo, int &count) {
+	co_await loop.signal(signo);
+	++count;
+}
+
+struct SignalCounter {
+	void call() {++this->count;}
+	int count = 0;
+};
+
+void testSignal() {
+	Loop_native loop;
+	int coroutineCount = 0;
+	waitSignal(loop, SIGUSR1, coroutineCount);
+	waitSignal(loop, SIGUSR1, coroutineCount);
+	SignalCounter counter;
+	Task<Callback> task(makeCallback<&SignalCounter::call>(&counter));
+	loop.invoke(task, SIGUSR2);
+
+	// the signals are blocked, therefore they stay pending until the loop reads them from the signalfd
+	raise(SIGUSR1);
+	raise(SIGUSR2);
+	for (int i = 0; i < 10 && (coroutineCount < 2 || counter.count < 1); ++i)
+		loop.handleEvents(100);
+	check(coroutineCount == 2, "all coroutines waiting on the signal get resumed");
+	check(counter.count == 1, "task waiting on the signal gets called");
+
+	// the task gets called only once
+	raise(SIGUSR2);
+	loop.handleEvents(100);
+	check(counter.count == 1, "task waiting on the signal gets called once");
+}
+#endif
+
+#ifdef __linux__
+// the events of a burst for the same path get reported as one change after the coalescing window
+struct Change {
+	int wd;
+	std::string name;
+	uint32_t events;
+};
+
+Coroutine watchChanges(Loop_native &loop, Loop_native::FileWatcher &watcher, std::vector<Change> &changes) {
+	while (true) {
+		// stop when no change is reported for a while
+		bool changed = co_await loop.withTimeout(watcher.changed(), 200ms);
+		if (!changed)
+			break;
+		changes.push_back({watcher.wd, watcher.name, watcher.events});
+	}
+	loop.exit();
+}
+
+void testFileWatcher() {
+	char dir[] = "/tmp/LoopNativeTestXXXXXX";
+	check(mkdtemp(dir) != nullptr, "mkdtemp");
+	std::string path1 = std::string(dir) + "/file1";
+	std::string path2 = std::string(dir) + "/file2";
+
+	Loop_native loop;
+	Loop_native::FileWatcher watcher(loop, 50ms);
+	int watchWd = watcher.watch(dir, IN_CREATE | IN_CLOSE_WRITE);
+	check(watchWd >= 0, "watch");
+	std::vector<Change> changes;
+	watchChanges(loop, watcher, changes);
+
+	// create and write two files, this generates IN_CREATE and IN_CLOSE_WRITE for each file
+	for (auto &path : {path1, path2}) {
+		int fd = open(path.c_str(), O_CREAT | O_WRONLY, 0644);
+		check(fd >= 0 && write(fd, "x", 1) == 1, "write file");
+		close(fd);
+	}
+
+	// removing the watch generates IN_IGNORED
+	watcher.unwatch(watchWd);
+
+	// nothing gets reported before the window has elapsed
+	loop.handleEvents(10);
+	check(changes.empty(), "change is reported after the coalescing window");
+
+	loop.run();
+	check(changes.size() == 2, "events of a burst get coalesced into one change for each file");
+	if (changes.size() == 2) {
+		check(changes[0].name == "file1" && changes[1].name == "file2", "names of the changes");
+		for (auto &change : changes) {
+			check(change.wd == watchWd, "watch descriptor of the change");
+			check(change.events == (IN_CREATE | IN_CLOSE_WRITE), "events of the change");
+		}
+	}
+
+	unlink(path1.c_str());
+	unlink(path2.c_str());
+	rmdir(dir);
+}
+#endif
+
+#ifdef COCO_LOOP_IO_URING
+// operations that don't fit into the submission queue get submitted when the queue is full instead of failing
+Coroutine readPipe(Loop_IoUring &loop, Loop_IoUring::Operation &operation, int fd, int &result, int &count) {
+	char ch;
+	co_await operation.read(fd, &ch, 1);
+	result = operation.result;
+	if (--count == 0)
+		loop.exit();
+}
+
+void testFullSubmissionQueue() {
+	constexpr int COUNT = 16;
+	Loop_IoUring loop(4);
+	std::vector<std::unique_ptr<Loop_IoUring::Operation>> operations;
+	int fds[COUNT][2];
+	int results[COUNT] = {};
+	int count = COUNT;
+	for (int i = 0; i < COUNT; ++i) {
+		check(pipe(fds[i]) == 0, "pipe");
+		operations.push_back(std::make_unique<Loop_IoUring::Operation>(loop));
+		readPipe(loop, *operations[i], fds[i][0], results[i], count);
+	}
+	for (int i = 0; i < COUNT; ++i)
+		check(write(fds[i][1], "x", 1) == 1, "write");
+	loop.run();
+	for (int i = 0; i < COUNT; ++i) {
+		check(results[i] == 1, "read with full submission queue");
+		close(fds[i][0]);
+		close(fds[i][1]);
+	}
+}
+
+// an acceptor that has failed reports the error instead of waiting or accepting again
+Coroutine acceptOne(Loop_IoUring::Acceptor &acceptor, int &fd) {
+	co_await acceptor.next();
+	fd = acceptor.fd;
+}
+
+void testAcceptError() {
+	Loop_IoUring loop;
+
+	// accept on a socket that is not listening fails with -EINVAL
+	int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	Loop_IoUring::Acceptor acceptor(loop, listenFd);
+	loop.handleEvents(10);
+	int fd1 = 0;
+	int fd2 = 0;
+	acceptOne(acceptor, fd1);
+	acceptOne(acceptor, fd2);
+	check(fd1 == -EINVAL && fd2 == -EINVAL, "accept error is reported");
+	close(listenFd);
+}
+
+// a receiver that has stopped because another receiver used up the shared buffer ring receives again when that
+// receiver releases a buffer
+Coroutine receiveAll(Loop_IoUring::Receiver &receiver, int &count) {
+	while (true) {
+		co_await receiver.next();
+		if (receiver.size <= 0)
+			break;
+		++count;
+		receiver.release();
+	}
+}
+
+void testStalledReceiver() {
+	Loop_IoUring loop;
+	check(loop.registerBufferRing(2, 64), "buffer ring");
+	int sockets1[2];
+	int sockets2[2];
+	check(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets1) == 0, "socketpair");
+	check(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets2) == 0, "socketpair");
+	{
+		Loop_IoUring::Receiver receiver1(loop, sockets1[0]);
+		Loop_IoUring::Receiver receiver2(loop, sockets2[0]);
+		int count2 = 0;
+		receiveAll(receiver2, count2);
+
+		// the first receiver holds both buffers
+		for (int i = 0; i < 2; ++i) {
+			check(write(sockets1[1], "x", 1) == 1, "write");
+			loop.handleEvents(10);
+		}
+
+		// the second receiver stops as the buffer ring is empty
+		check(write(sockets2[1], "y", 1) == 1, "write");
+		loop.handleEvents(10);
+		check(count2 == 0, "buffer ring is empty");
+
+		// the first receiver releases its buffers
+		for (int i = 0; i < 2; ++i) {
+			auto next = receiver1.next();
+			receiver1.release();
+		}
+		for (int i = 0; i < 10 && count2 == 0; ++i)
+			loop.handleEvents(10);
+		check(count2 == 1, "stalled receiver receives again");
+
+		// end of stream finishes the coroutine
+		close(sockets2[1]);
+		for (int i = 0; i < 10 && receiver2.size != 0; ++i)
+			loop.handleEvents(10);
+	}
+	close(sockets1[0]);
+	close(sockets1[1]);
+	close(sockets2[0]);
+}
+
+// a handler that gets cancelled by another handler of the same batch of completions does not get called
+struct CancelingHandler : public Loop_IoUring::CompletionHandler {
+	CancelingHandler(Loop_IoUring &loop) : loop(loop) {}
+	void handle(int result, uint32_t flags) override {
+		++this->count;
+		if (this->other != nullptr)
+			this->loop.cancel(*this->other);
+	}
+
+	Loop_IoUring &loop;
+	CancelingHandler *other = nullptr;
+	int count = 0;
+};
+
+void testCancelInBatch() {
+	Loop_IoUring loop;
+	CancelingHandler first(loop);
+	CancelingHandler second(loop);
+	first.other = &second;
+	for (auto handler : {&first, &second}) {
+		auto sqe = loop.getSubmission(*handler);
+		check(sqe != nullptr, "submission");
+		if (sqe != nullptr)
+			sqe->opcode = IORING_OP_NOP;
+	}
+	loop.handleEvents(100);
+	check(first.count == 1, "first handler gets called");
+	check(second.count == 0, "handler that was cancelled by a handler of the same batch does not get called");
+}
+
+// a read that times out gets cancelled in the kernel, afterwards the operation can be used again
+Coroutine readWithTimeout(Loop_IoUring &loop, Loop_IoUring::Operation &operation, int readFd, int writeFd,
+	int &timeoutResult, int &result)
+{
+	static_assert(CancelableAwaitable<Loop_IoUring::Operation::Completion>);
+	char ch;
+	if (!co_await loop.withTimeout(operation.read(readFd, &ch, 1), 20ms))
+		timeoutResult = operation.result;
+
+	// wait until the completion of the cancelled read has arrived
+	co_await loop.sleep(20ms);
+
+	// the data must not be consumed by the cancelled read
+	check(write(writeFd, "x", 1) == 1, "write");
+	if (co_await loop.withTimeout(operation.read(readFd, &ch, 1), 500ms))
+		result = operation.result;
+	loop.exit();
+}
+
+void testCancelOperation() {
+	Loop_IoUring loop;
+	Loop_IoUring::Operation operation(loop);
+	int fds[2];
+	check(pipe(fds) == 0, "pipe");
+	int timeoutResult = 0;
+	int result = 0;
+	readWithTimeout(loop, operation, fds[0], fds[1], timeoutResult, result);
+	loop.run();
+	check(timeoutResult == -ECANCELED, "read times out");
+	check(result == 1, "read after timeout");
+	close(fds[0]);
+	close(fds[1]);
+}
+
+// an operation that gets destroyed while its read is submitted or still queued does not consume the data
+void testDestroyOperation() {
+	Loop_IoUring loop;
+	int fds[2];
+	check(pipe(fds) == 0, "pipe");
+	char ch = 0;
+	{
+		Loop_IoUring::Operation operation(loop);
+		auto completion = operation.read(fds[0], &ch, 1);
+		loop.submit();
+	}
+	{
+		Loop_IoUring::Operation operation(loop);
+		auto completion = operation.read(fds[0], &ch, 1);
+	}
+	check(write(fds[1], "x", 1) == 1, "write");
+	loop.handleEvents(10);
+	pollfd readable = {fds[0], POLLIN, 0};
+	check(poll(&readable, 1, 100) == 1 && read(fds[0], &ch, 1) == 1, "data is not read by destroyed operations");
+	close(fds[0]);
+	close(fds[1]);
+}
+#endif
+
+int main() {
+	testCachedNow();
+	testPost();
+	testSlack();
+	testPeriodic(Loop::Periodic::Policy::SKIP, {100, 360, 400, 500, 600}, {0, 1, 0, 0, 0}, "periodic SKIP");
+	testPeriodic(Loop::Periodic::Policy::BURST, {100, 360, 360, 400, 500}, {0, 0, 0, 0, 0}, "periodic BURST");
+	testPeriodic(Loop::Periodic::Policy::DELAY, {100, 360, 460, 560, 660}, {0, 1, 0, 0, 0}, "periodic DELAY");
+	testZeroPeriod();
+	testTimeout();
+	testOffload();
+	testYieldOrder();
+	testYieldStarvation();
+#ifdef __linux__
+	testSignal();
+	testFileWatcher();
+#endif
+#ifdef COCO_LOOP_IO_URING
+	testFullSubmissionQueue();
+	testCancelInBatch();
+	testAcceptError();
+	testStalledReceiver();
+	testCancelOperation();
+	testDestroyOperation();
+#endif
+
+	return result();
+}
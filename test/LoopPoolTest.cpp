@@ -0,0 +1,301 @@
+#include <coco/platform/Async_native.hpp>
+#include <coco/platform/Channel.hpp>
+#include <coco/platform/LoopPool.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "Check.hpp"
+
+using namespace coco;
+
+
+// Checks the behavior of the pool of native loops, returns nonzero on failure
+
+
+// handlers posted to a loop run on the thread of that loop
+void testDispatch() {
+	LoopPool pool(3);
+	std::atomic<int> wrongLoop = 0;
+	std::atomic<int> count = 0;
+	for (int i = 0; i < pool.size(); ++i) {
+		pool.on(i).post([&pool, &wrongLoop, &count, i] {
+			if (pool.currentIndex() != i || &pool.currentLoop() != &pool.on(i))
+				++wrongLoop;
+			++count;
+		});
+	}
+	for (std::size_t key = 0; key < 10; ++key)
+		check(&pool.forKey(key) == &pool.forKey(key + pool.size()), "same loop for the same key");
+	check(pool.currentIndex() == -1, "main thread does not belong to the pool");
+
+	// the handlers posted before exit() still get called
+	pool.exit();
+	pool.join();
+	check(count == pool.size(), "posted handlers get called before the loops exit");
+	check(wrongLoop == 0, "posted handlers run on their loop");
+}
+
+// a loop of the pool can exit the pool, the owner waits for the threads
+void testExitFromLoop() {
+	LoopPool pool(2);
+	bool exited = false;
+	pool.on(1).post([&pool, &exited] {
+		pool.exit();
+
+		// calling exit() again has no effect
+		pool.exit();
+		exited = true;
+	});
+	pool.join();
+	check(exited, "exit from a loop");
+}
+
+// each element of the work-stealing deque is taken exactly once, by the owner or by a thief
+void testDeque() {
+	constexpr int COUNT = 100000;
+	constexpr int THIEF_COUNT = 3;
+	WorkStealingDeque<int, 64> deque;
+
+	// owner pops in LIFO order, thieves steal in FIFO order
+	deque.push(1);
+	deque.push(2);
+	deque.push(3);
+	int value = 0;
+	check(deque.steal(value) && value == 1, "steal takes the oldest element");
+	check(deque.pop(value) && value == 3, "pop takes the newest element");
+	check(deque.pop(value) && value == 2 && !deque.pop(value), "deque is empty");
+
+	std::vector<std::atomic<int>> taken(COUNT);
+	std::atomic<bool> done = false;
+	std::vector<std::thread> thieves;
+	for (int i = 0; i < THIEF_COUNT; ++i) {
+		thieves.emplace_back([&] {
+			int element;
+			while (!done) {
+				if (deque.steal(element))
+					++taken[element];
+			}
+		});
+	}
+	int next = 0;
+	while (next < COUNT) {
+		// push a batch, pop some of it, the thieves steal the rest
+		for (int i = 0; i < 16 && next < COUNT; ++i) {
+			if (deque.push(next))
+				++next;
+		}
+		int element;
+		for (int i = 0; i < 8 && deque.pop(element); ++i)
+			++taken[element];
+	}
+	int element;
+	while (deque.pop(element))
+		++taken[element];
+	done = true;
+	for (auto &thief : thieves)
+		thief.join();
+
+	bool once = true;
+	for (auto &count : taken)
+		once &= count == 1;
+	check(once, "each element is taken exactly once");
+}
+
+// idle loops steal scheduled coroutines from a busy loop
+Coroutine work(LoopPool &pool, std::atomic<int> &count, std::atomic<int> &otherLoopCount) {
+	co_await pool.schedule();
+
+	// keep the loop busy so that the other loops steal
+	if (pool.currentIndex() != 0)
+		++otherLoopCount;
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	++count;
+}
+
+void testStealing() {
+	constexpr int COUNT = 100;
+	LoopPool pool(4, true);
+	std::atomic<int> count = 0;
+	std::atomic<int> otherLoopCount = 0;
+
+	// schedule all coroutines on loop 0
+	pool.on(0).post([&] {
+		for (int i = 0; i < COUNT; ++i)
+			work(pool, count, otherLoopCount);
+	});
+	for (int i = 0; i < 500 && count < COUNT; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	pool.exit();
+	pool.join();
+
+	int stealCount = 0;
+	for (int i = 0; i < pool.size(); ++i)
+		stealCount += pool.stealCount(i);
+	check(count == COUNT, "all scheduled coroutines are resumed");
+	check(stealCount > 0 && stealCount == otherLoopCount, "idle loops steal coroutines");
+}
+
+// coroutines that keep scheduling themselves on the same loop take turns
+Coroutine takeTurns(LoopPool &pool, int id, std::vector<int> &order, std::atomic<int> &doneCount) {
+	for (int i = 0; i < 100; ++i) {
+		co_await pool.schedule();
+		order.push_back(id);
+	}
+	++doneCount;
+}
+
+void testFairness() {
+	constexpr int COUNT = 3;
+	LoopPool pool(1);
+	std::vector<int> order;
+	std::atomic<int> doneCount = 0;
+	pool.on(0).post([&] {
+		for (int id = 0; id < COUNT; ++id)
+			takeTurns(pool, id, order, doneCount);
+	});
+	for (int i = 0; i < 500 && doneCount < COUNT; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	pool.exit();
+	pool.join();
+
+	bool inTurn = doneCount == COUNT && order.size() == COUNT * 100;
+	for (size_t i = 0; inTurn && i < order.size(); ++i)
+		inTurn = order[i] == int(i % COUNT);
+	check(inTurn, "scheduled coroutines are resumed in FIFO order");
+}
+
+// values sent from several loops arrive exactly once and in the order of each sender, also when the channel is full
+constexpr int SEND_COUNT = 20000;
+
+Coroutine sendValues(Loop_native &loop, Channel<int, 16> &channel, int sender) {
+	for (int i = 0; i < SEND_COUNT; ++i)
+		co_await channel.send(loop, sender * SEND_COUNT + i);
+}
+
+Coroutine receiveValues(Channel<int, 16> &channel, int senderCount, std::atomic<bool> &inOrder,
+	std::atomic<bool> &done)
+{
+	std::vector<int> next(senderCount, 0);
+	bool ordered = true;
+	for (int i = 0; i < senderCount * SEND_COUNT; ++i) {
+		int value = co_await channel.receive();
+		int sender = value / SEND_COUNT;
+		ordered &= value % SEND_COUNT == next[sender];
+		next[sender] = value % SEND_COUNT + 1;
+	}
+	inOrder = ordered;
+	done = true;
+}
+
+void testChannel() {
+	LoopPool pool(3);
+	Channel<int, 16> channel(pool.on(0));
+	std::atomic<bool> inOrder = false;
+	std::atomic<bool> done = false;
+	pool.on(0).post([&] {receiveValues(channel, 2, inOrder, done);});
+	for (int i = 1; i <= 2; ++i) {
+		auto &loop = pool.on(i);
+		loop.post([&loop, &channel, i] {sendValues(loop, channel, i - 1);});
+	}
+	for (int i = 0; i < 1000 && !done; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	pool.exit();
+	pool.join();
+	check(done, "all values are received");
+	check(inOrder, "values of each sender are received in order");
+
+	int value;
+	check(!channel.tryReceive(value), "channel is empty");
+}
+
+// the native primitives synchronize coroutines on different loops
+constexpr int ROUND_COUNT = 1000;
+
+struct Shared {
+	AsyncMutex_native mutex;
+	AsyncSemaphore_native semaphore{2};
+	AsyncBarrier_native barrier{3};
+
+	// protected by the mutex
+	int counter = 0;
+	bool inside = false;
+	bool overlap = false;
+
+	// number of coroutines that hold a permit of the semaphore
+	std::atomic<int> holding = 0;
+	std::atomic<int> maxHolding = 0;
+
+	// number of coroutines that have arrived at the barrier in each phase
+	std::atomic<int> arrived[5] = {};
+	std::atomic<bool> early = false;
+	std::atomic<int> doneCount = 0;
+};
+
+Coroutine synchronize(Loop_native &loop, Shared &shared) {
+	// increment the counter under the lock, the coroutine yields while holding the lock
+	for (int i = 0; i < ROUND_COUNT; ++i) {
+		co_await shared.mutex.lock(loop);
+		if (shared.inside)
+			shared.overlap = true;
+		shared.inside = true;
+		int counter = shared.counter;
+		co_await loop.yield();
+		shared.counter = counter + 1;
+		shared.inside = false;
+		shared.mutex.unlock();
+	}
+
+	// hold a permit of the semaphore for a while
+	for (int i = 0; i < 100; ++i) {
+		co_await shared.semaphore.acquire(loop);
+		int holding = ++shared.holding;
+		int maxHolding = shared.maxHolding;
+		while (holding > maxHolding && !shared.maxHolding.compare_exchange_weak(maxHolding, holding)) {}
+		co_await loop.yield();
+		--shared.holding;
+		shared.semaphore.release();
+	}
+
+	// pass the barrier in several phases, all coroutines have arrived when one continues
+	for (int phase = 0; phase < 5; ++phase) {
+		++shared.arrived[phase];
+		co_await shared.barrier.arrive(loop);
+		if (shared.arrived[phase] != 3)
+			shared.early = true;
+	}
+	++shared.doneCount;
+}
+
+void testAsync() {
+	LoopPool pool(3);
+	Shared shared;
+	for (int i = 0; i < 3; ++i) {
+		auto &loop = pool.on(i);
+		loop.post([&loop, &shared] {synchronize(loop, shared);});
+	}
+	for (int i = 0; i < 1000 && shared.doneCount < 3; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	pool.exit();
+	pool.join();
+	check(shared.doneCount == 3, "all coroutines finish");
+	check(shared.counter == 3 * ROUND_COUNT && !shared.overlap, "mutex excludes coroutines on other loops");
+	check(shared.maxHolding <= 2 && shared.holding == 0, "semaphore limits the number of permits");
+	check(!shared.early, "barrier waits for all coroutines");
+
+	// an extra unlock() does not let two coroutines lock the mutex
+	shared.mutex.unlock();
+	check(shared.mutex.tryLock() && !shared.mutex.tryLock(), "mutex has at most one permit");
+}
+
+int main() {
+	testDispatch();
+	testExitFromLoop();
+	testDeque();
+	testStealing();
+	testFairness();
+	testChannel();
+	testAsync();
+
+	return result();
+}
@@ -0,0 +1,87 @@
+#include <coco/Callback.hpp>
+#include <coco/Coroutine.hpp>
+#include <coco/TimerHeap.hpp>
+#include <coco/TimerList.hpp>
+#include <coco/TimerWheel.hpp>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+
+using namespace coco;
+
+
+// Compares insert, cancel and fire throughput of the timer stores at different numbers of timers
+
+using Time = TimeMilliseconds<>;
+
+// timeouts are distributed over one minute
+constexpr int RANGE = 60000;
+
+struct Counter {
+	void inc() {++this->count;}
+	int count = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// nanoseconds per operation
+double perOperation(Clock::time_point start, int count) {
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+}
+
+template <typename S>
+void benchmark(const char *name, int count) {
+	Counter counter;
+	std::allocator<TimedTask<Callback>> allocator;
+	auto tasks = allocator.allocate(count);
+	for (int i = 0; i < count; ++i)
+		new (&tasks[i]) TimedTask<Callback>(makeCallback<&Counter::inc>(&counter));
+	std::mt19937 random(count);
+	std::uniform_int_distribution<int> distribution(0, RANGE - 1);
+	Time base(1000);
+
+	// the store is large for the timing wheel and heap, therefore allocate on the heap
+	auto store = std::make_unique<S>();
+	store->doUntil(base);
+
+	// insert
+	auto start = Clock::now();
+	for (int i = 0; i < count; ++i) {
+		tasks[i].cancelAndSet(base + distribution(random) * 1ms);
+		store->add(tasks[i]);
+	}
+	double insert = perOperation(start, count);
+
+	// cancel every second task
+	start = Clock::now();
+	for (int i = 0; i < count; i += 2)
+		tasks[i].cancel();
+	double cancel = perOperation(start, (count + 1) / 2);
+
+	// fire the remaining tasks by advancing the time in steps of one millisecond like the loop does
+	start = Clock::now();
+	for (int t = 0; t < RANGE; ++t) {
+		Time time = base + t * 1ms;
+		if (store->getFirstTime(time) <= time)
+			store->doUntil(time);
+	}
+	double fire = perOperation(start, count / 2);
+
+	std::cout << name << " " << count << " timers: insert " << insert << "ns, cancel " << cancel << "ns, fire "
+		<< fire << "ns (" << counter.count << " fired)" << std::endl;
+
+	for (int i = 0; i < count; ++i)
+		tasks[i].~TimedTask<Callback>();
+	allocator.deallocate(tasks, count);
+}
+
+int main() {
+	for (int count : {10, 1000, 100000}) {
+		benchmark<TimerList<TimedTaskList<Callback>>>("list", count);
+		benchmark<TimerWheel<TimedTaskList<Callback>>>("wheel", count);
+		benchmark<TimerHeap<TimedTaskList<Callback>>>("heap", count);
+		benchmark<TimerHeap<TimedTaskList<Callback>, 1024>>("heap1024", count);
+	}
+	return 0;
+}
@@ -0,0 +1,166 @@
+#include <coco/Callback.hpp>
+#include <coco/Coroutine.hpp>
+#include <coco/TimerHeap.hpp>
+#include <coco/TimerList.hpp>
+#include <coco/TimerWheel.hpp>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Check.hpp"
+
+using namespace coco;
+
+
+// Checks that the timing wheel and the heap call the tasks in the same order as the sorted list and that tasks which
+// are added to the list returned by list() after other timers have expired are not lost
+
+using Time = TimeMilliseconds<>;
+
+// timer that records its id when it gets called
+struct Timer {
+	Timer(int id, std::vector<int> &called) : task(makeCallback<&Timer::call>(this)), id(id), called(called) {}
+	void call() {this->called.push_back(this->id);}
+
+	TimedTask<Callback> task;
+	int id;
+	std::vector<int> &called;
+};
+
+// compare the order in which the tasks get called for random inserts, cancels and time steps
+void testRandomOrder(int seed, int range, int maxStep) {
+	constexpr int COUNT = 200;
+	std::vector<int> listCalled;
+	std::vector<int> wheelCalled;
+	std::vector<int> heapCalled;
+	std::vector<std::unique_ptr<Timer>> listTimers;
+	std::vector<std::unique_ptr<Timer>> wheelTimers;
+	std::vector<std::unique_ptr<Timer>> heapTimers;
+	for (int i = 0; i < COUNT; ++i) {
+		listTimers.push_back(std::make_unique<Timer>(i, listCalled));
+		wheelTimers.push_back(std::make_unique<Timer>(i, wheelCalled));
+		heapTimers.push_back(std::make_unique<Timer>(i, heapCalled));
+	}
+
+	// the stores are large, therefore allocate on the heap
+	auto list = std::make_unique<TimerList<TimedTaskList<Callback>>>();
+	auto wheel = std::make_unique<TimerWheel<TimedTaskList<Callback>, 64>>();
+	auto heap = std::make_unique<TimerHeap<TimedTaskList<Callback>, 64>>();
+
+	// start near the wrap around of the time
+	std::mt19937 random(seed);
+	Time time(0x7fffffff - 5000);
+	list->doUntil(time);
+	wheel->doUntil(time);
+	heap->doUntil(time);
+
+	for (int step = 0; step < 2000; ++step) {
+		// insert or cancel some tasks, the times include overdue tasks and tasks on the upper levels
+		int operationCount = random() % 8;
+		for (int j = 0; j < operationCount; ++j) {
+			int i = random() % COUNT;
+			if (random() % 4 == 0) {
+				listTimers[i]->task.cancel();
+				wheelTimers[i]->task.cancel();
+				heapTimers[i]->task.cancel();
+			} else {
+				Time t = time + (int(random() % range) - 20) * 1ms;
+				listTimers[i]->task.cancelAndSet(t);
+				list->add(listTimers[i]->task);
+				wheelTimers[i]->task.cancelAndSet(t);
+				wheel->add(wheelTimers[i]->task);
+				heapTimers[i]->task.cancelAndSet(t);
+				heap->add(heapTimers[i]->task);
+			}
+		}
+
+		// the wheel and the heap may report a first time that is too early after a cancel, but never too late
+		Time defaultTime = time + 1000 * 1ms;
+		check(!(list->getFirstTime(defaultTime) < wheel->getFirstTime(defaultTime)), "first time is too late");
+		check(!(list->getFirstTime(defaultTime) < heap->getFirstTime(defaultTime)), "first time is too late");
+		check(list->empty() == wheel->empty() && list->empty() == heap->empty(), "empty");
+
+		// advance the time in small steps and sometimes by a large step
+		time += (random() % 16 == 0 ? int(random() % maxStep) : int(random() % 5)) * 1ms;
+		list->doUntil(time);
+		wheel->doUntil(time);
+		heap->doUntil(time);
+		check(listCalled == wheelCalled && listCalled == heapCalled, "order of called tasks");
+	}
+	check(!listCalled.empty(), "tasks were called");
+}
+
+// sleep on a timer store like the loops do
+template <typename S>
+Awaitable<CoroutineTimedTask> sleep(S &store, Time time) {
+	return {store.list(time), time};
+}
+
+// create the awaitable, wait until the test lets the coroutine continue, then suspend on the awaitable
+template <typename S>
+Coroutine sleepLater(S &store, Time time, CoroutineTaskList<> &gate, bool &done) {
+	auto awaitable = sleep(store, time);
+	co_await Awaitable<>(gate);
+	co_await awaitable;
+	done = true;
+}
+
+template <typename S>
+Coroutine sleepNow(S &store, Time time, bool &done) {
+	co_await sleep(store, time);
+	done = true;
+}
+
+// a task that gets added to the list returned by list() after another timer has expired must not be lost
+template <typename S>
+void testLateSuspend(const char *name) {
+	auto store = std::make_unique<S>();
+	Time time(1000);
+	store->doUntil(time);
+
+	// create the awaitable for time + 10
+	CoroutineTaskList<> gate;
+	bool done = false;
+	sleepLater(*store, time + 10ms, gate, done);
+
+	// let another timer expire
+	bool otherDone = false;
+	sleepNow(*store, time + 5ms, otherDone);
+	check(store->getFirstTime(time + 1000ms) == time + 5ms, name);
+	store->doUntil(time + 5ms);
+	check(otherDone, name);
+	check(store->empty(), name);
+
+	// now suspend on the awaitable
+	gate.doFirst();
+	check(!done, name);
+	check(store->getFirstTime(time + 1000ms) == time + 10ms, name);
+	store->doUntil(time + 9ms);
+	check(!done, name);
+	store->doUntil(time + 10ms);
+	check(done, name);
+
+	// suspend after the time of the awaitable has passed
+	done = false;
+	sleepLater(*store, time + 20ms, gate, done);
+	store->doUntil(time + 30ms);
+	gate.doFirst();
+	check(!(time + 30ms < store->getFirstTime(time + 1000ms)), name);
+	store->doUntil(time + 30ms);
+	check(done, name);
+	check(store->empty(), name);
+}
+
+int main() {
+	for (int seed = 1; seed <= 10; ++seed) {
+		// level 0 and the first upper level
+		testRandomOrder(seed, 400, 300);
+
+		// cascading from the upper levels
+		testRandomOrder(seed, 1 << 20, 1 << 16);
+	}
+	testLateSuspend<TimerList<CoroutineTimedTaskList>>("late suspend list");
+	testLateSuspend<TimerWheel<CoroutineTimedTaskList>>("late suspend wheel");
+	testLateSuspend<TimerHeap<CoroutineTimedTaskList>>("late suspend heap");
+
+	return result();
+}